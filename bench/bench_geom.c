@@ -0,0 +1,128 @@
+/*
+ * geom.h (固定小数点) と従来の double 実装の比較。
+ * 速度 (ns/call) と精度 (角度の最大誤差・リング判定の不一致) を表示する。
+ */
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../wcircle/geom.h"
+
+#define NPOINTS 4096
+#define ROUNDS  2000
+
+typedef struct {
+    int x_min, x_max, y_min, y_max;
+    double ratio_min, ratio_max;
+} ref_t;
+
+/* ---- 従来の double 実装 ---- */
+
+static inline double ref_angle_diff(double a, double b){
+    double d = a - b;
+    while (d >  M_PI) d -= 2*M_PI;
+    while (d < -M_PI) d += 2*M_PI;
+    return d;
+}
+
+static bool ref_in_ring(int x, int y, const ref_t *a){
+    double nx = (double)(x - a->x_min) / (double)(a->x_max - a->x_min) * 2.0 - 1.0;
+    double ny = (double)(y - a->y_min) / (double)(a->y_max - a->y_min) * 2.0 - 1.0;
+    double r = sqrt(nx*nx + ny*ny);
+    return (r >= a->ratio_min && r <= a->ratio_max);
+}
+
+static double ref_to_ang(int x, int y, const ref_t *a){
+    double nx = ((double)x - a->x_min) / (double)(a->x_max - a->x_min) * 2.0 - 1.0;
+    double ny = ((double)y - a->y_min) / (double)(a->y_max - a->y_min) * 2.0 - 1.0;
+    return atan2(ny, nx);
+}
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile long sink;
+
+int main(void){
+    const ref_t ref = { 0, 1216, 0, 680, 0.70, 1.415 };
+    geom_t g;
+    geom_init(&g, ref.x_min, ref.x_max, ref.y_min, ref.y_max, ref.ratio_min, ref.ratio_max);
+
+    static int xs[NPOINTS], ys[NPOINTS];
+    srand(1);
+    for (int i = 0; i < NPOINTS; i++) {
+        xs[i] = ref.x_min + rand() % (ref.x_max - ref.x_min + 1);
+        ys[i] = ref.y_min + rand() % (ref.y_max - ref.y_min + 1);
+    }
+
+    /* 精度: パッド上の全格子点 */
+    double max_err = 0.0;
+    long mismatch = 0, mismatch_far = 0, total = 0;
+    for (int x = ref.x_min; x <= ref.x_max; x++) {
+        for (int y = ref.y_min; y <= ref.y_max; y++) {
+            if (2 * x == ref.x_min + ref.x_max && 2 * y == ref.y_min + ref.y_max) continue;
+            double e = fabs(ref_angle_diff(geom_ang_to_rad(geom_angle(&g, x, y)), ref_to_ang(x, y, &ref)));
+            if (e > max_err) max_err = e;
+            total++;
+            if (geom_in_ring(&g, x, y) != ref_in_ring(x, y, &ref)) {
+                mismatch++;
+                double nx = (double)(x - ref.x_min) / (ref.x_max - ref.x_min) * 2.0 - 1.0;
+                double ny = (double)(y - ref.y_min) / (ref.y_max - ref.y_min) * 2.0 - 1.0;
+                double r = sqrt(nx*nx + ny*ny);
+                if (fabs(r - ref.ratio_min) > 1e-4 && fabs(r - ref.ratio_max) > 1e-4) mismatch_far++;
+            }
+        }
+    }
+    printf("angle_max_error_deg=%.5f\n", max_err * 180.0 / M_PI);
+    printf("ring_mismatch=%ld\n", mismatch);
+    printf("ring_total=%ld\n", total);
+    printf("ring_mismatch_far=%ld\n", mismatch_far);
+
+    /* 速度 */
+    double t0, t1;
+    long acc = 0;
+    double dacc = 0;
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) dacc += ref_to_ang(xs[i], ys[i], &ref);
+    t1 = now_ns();
+    printf("to_ang_double_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) acc += geom_angle(&g, xs[i], ys[i]);
+    t1 = now_ns();
+    printf("to_ang_fixed_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) acc += ref_in_ring(xs[i], ys[i], &ref);
+    t1 = now_ns();
+    printf("in_ring_double_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) acc += geom_in_ring(&g, xs[i], ys[i]);
+    t1 = now_ns();
+    printf("in_ring_fixed_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 1; i < NPOINTS; i++) dacc += ref_angle_diff(xs[i] * 0.01, ys[i - 1] * 0.01);
+    t1 = now_ns();
+    printf("angle_diff_double_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 1; i < NPOINTS; i++) acc += geom_ang_diff((geom_ang_t)(xs[i] * 53), (geom_ang_t)(ys[i - 1] * 97));
+    t1 = now_ns();
+    printf("angle_diff_fixed_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    sink = acc + (long)dacc;
+    return 0;
+}
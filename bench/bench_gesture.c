@@ -0,0 +1,280 @@
+/*
+ * ジェスチャ処理のベンチマーク。
+ *   - to_ang (geom_angle) / is_in_touch_area (geom_in_ring) / angle_diff /
+ *     update_xy_before_scroll / update_xy_while_scroll の1回あたり [ns]
+ *   - イベント列 (録画ファイル、無ければ合成) を drain_events() から状態遷移まで通し、
+ *     null sink に出したときの events/s・ns/frame・計測中の malloc 回数
+ * 結果は key=value で標準出力に出す (make bench がファイルに残す)。
+ *
+ * static 関数を直接呼ぶため wcircle.c と engine.c をそのまま取り込む。
+ */
+#define main wcircle_main
+#include "../wcircle/wcircle.c"
+#undef main
+#include "../wcircle/engine.c"
+
+#define NPOINTS 4096
+#define ROUNDS  2000
+#define E2E_MIN_EVENTS 2000000   // これ以上のイベントを流すまで繰り返す
+
+/* ---- malloc の回数 (-Wl,--wrap で差し替え) ---- */
+
+static unsigned long allocs;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__wrap_malloc(size_t size) { allocs++; return __real_malloc(size); }
+void *__wrap_calloc(size_t n, size_t size) { allocs++; return __real_calloc(n, size); }
+void *__wrap_realloc(void *p, size_t size) { allocs++; return __real_realloc(p, size); }
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile long bench_sink;
+
+static void bench_config(config_t *cfg){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->outer_ratio_min = 0.70;
+    cfg->outer_ratio_max = 1.415;
+    cfg->start_arc_rad   = 5.0*DEG2RAD;
+    cfg->step_rad        = 18.0*DEG2RAD;
+    cfg->wheel_step      = 1;
+    cfg->log_level       = LOG_LVL_INFO;
+}
+
+/* ---- イベント列 ---- */
+
+typedef struct {
+    struct input_event *evs;
+    size_t n, cap, pos;
+    size_t frames;
+    bool in_sync;
+    struct input_absinfo xi, yi;
+} stream_t;
+
+static void push(stream_t *s, int64_t t_us, int type, int code, int value){
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->evs = realloc(s->evs, s->cap * sizeof(*s->evs));
+        if (!s->evs) DIE("out of memory");
+    }
+    struct input_event *ev = &s->evs[s->n++];
+    memset(ev, 0, sizeof(*ev));
+    ev->input_event_sec = t_us / 1000000;
+    ev->input_event_usec = t_us % 1000000;
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+    if (type == EV_SYN && code == SYN_REPORT) s->frames++;
+}
+
+// 中央での移動 (passthrough) と外周の回転 (scroll) を交互に行う MT 風の列
+static void synth_stream(stream_t *s){
+    memset(s, 0, sizeof(*s));
+    s->xi = (struct input_absinfo){ .minimum = 0, .maximum = 1216 };
+    s->yi = (struct input_absinfo){ .minimum = 0, .maximum = 680 };
+    int64_t t = 1000000;
+    for (int g = 0; g < 20; g++) {
+        bool scroll = g % 2 == 1;
+        for (int i = 0; i < 300; i++) {
+            int x, y;
+            if (scroll) {
+                x = 608 + (int)(580 * cos(i * 0.05));
+                y = 340 + (int)(325 * sin(i * 0.05));
+            } else {
+                x = 500 + i;
+                y = 300 + i / 2;
+            }
+            push(s, t, EV_ABS, ABS_MT_SLOT, 0);
+            if (i == 0) push(s, t, EV_ABS, ABS_MT_TRACKING_ID, 100 + g);
+            push(s, t, EV_ABS, ABS_MT_POSITION_X, x);
+            push(s, t, EV_ABS, ABS_MT_POSITION_Y, y);
+            if (i == 0) {
+                push(s, t, EV_KEY, BTN_TOUCH, 1);
+                push(s, t, EV_KEY, BTN_TOOL_FINGER, 1);
+            }
+            push(s, t, EV_ABS, ABS_X, x);
+            push(s, t, EV_ABS, ABS_Y, y);
+            push(s, t, EV_SYN, SYN_REPORT, 0);
+            t += 7000;
+        }
+        push(s, t, EV_ABS, ABS_MT_SLOT, 0);
+        push(s, t, EV_ABS, ABS_MT_TRACKING_ID, -1);
+        push(s, t, EV_KEY, BTN_TOUCH, 0);
+        push(s, t, EV_KEY, BTN_TOOL_FINGER, 0);
+        push(s, t, EV_SYN, SYN_REPORT, 0);
+        t += 200000;
+    }
+}
+
+// 録画ファイルをメモリに読み込む (SYN_DROPPED の同期列もそのまま並べる)
+static void load_stream(stream_t *s, const char *path){
+    replay_t rp;
+    memset(s, 0, sizeof(*s));
+    int rc = replay_open(&rp, path, false);
+    if (rc < 0) DIE("open replay file '%s': %s", path, strerror(-rc));
+    s->xi = rp.hdr.abs_x;
+    s->yi = rp.hdr.abs_y;
+    struct input_event ev;
+    while ((rc = replay_next_event(&rp, LIBEVDEV_READ_FLAG_NORMAL, &ev)) != -ENODATA) {
+        if (rc < 0) DIE("read replay file '%s': %s", path, strerror(-rc));
+        push(s, 0, ev.type, ev.code, ev.value);
+        s->evs[s->n - 1] = ev;
+    }
+    replay_close(&rp);
+}
+
+// メモリ上の列を libevdev_next_event() 互換で返す (同期列の扱いは replay_next_event と同じ)
+static int stream_next_event(void *src, unsigned int flags, struct input_event *ev){
+    stream_t *s = src;
+    if ((flags & LIBEVDEV_READ_FLAG_SYNC) && !s->in_sync) return -EAGAIN;
+    if (s->pos == s->n) return -ENODATA;
+    *ev = s->evs[s->pos++];
+    if (s->in_sync) {
+        if (ev->type == EV_SYN && ev->code == SYN_REPORT) s->in_sync = false;
+        return LIBEVDEV_READ_STATUS_SYNC;
+    }
+    if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+        s->in_sync = true;
+        return LIBEVDEV_READ_STATUS_SYNC;
+    }
+    return LIBEVDEV_READ_STATUS_SUCCESS;
+}
+
+/* ---- end-to-end ---- */
+
+static void bench_e2e(const char *prefix, stream_t *s, int catchup_frames){
+    app_t a;
+    stats_t stats;
+    memset(&a, 0, sizeof(a));
+    bench_config(&a.cfg);
+    a.cfg.catchup_frames = catchup_frames;
+    init_app(&a, &s->xi, &s->yi);
+    stats_init(&stats, false);
+    a.stats = &stats;
+    a.pad_out = sink_null_new();
+    a.mouse_out = sink_null_new();
+
+    unsigned long rounds = E2E_MIN_EVENTS / s->n + 1;
+    unsigned long allocs0 = allocs;
+    double t0 = now_ns();
+    for (unsigned long r = 0; r < rounds; r++) {
+        s->pos = 0;
+        s->in_sync = false;
+        drain_events(&a, stream_next_event, s);
+    }
+    double t1 = now_ns();
+    unsigned long nallocs = allocs - allocs0;
+
+    double sec = (t1 - t0) * 1e-9;
+    unsigned long events = rounds * s->n, frames = rounds * s->frames;
+    printf("%s_events=%lu\n", prefix, events);
+    printf("%s_frames=%lu\n", prefix, frames);
+    printf("%s_events_per_sec=%.0f\n", prefix, events / sec);
+    printf("%s_ns_per_event=%.2f\n", prefix, (t1 - t0) / events);
+    printf("%s_ns_per_frame=%.2f\n", prefix, (t1 - t0) / frames);
+    printf("%s_wheel_frames=%lu\n", prefix, stats.wheel_frames);
+    printf("%s_allocs=%lu\n", prefix, nallocs);
+    sink_close(a.pad_out);
+    sink_close(a.mouse_out);
+}
+
+int main(int argc, char **argv){
+    stream_t s;
+    if (argc > 1) {
+        load_stream(&s, argv[1]);
+        printf("stream=%s\n", argv[1]);
+    } else {
+        synth_stream(&s);
+        printf("stream=synthetic\n");
+    }
+    if (s.frames == 0) DIE("no frames in stream");
+
+    /* ---- マイクロベンチマーク ---- */
+    app_t a;
+    stats_t stats;
+    memset(&a, 0, sizeof(a));
+    bench_config(&a.cfg);
+    init_app(&a, &s.xi, &s.yi);
+    stats_init(&stats, false);
+    a.stats = &stats;
+    a.mouse_out = sink_null_new();
+    engine_t *e = &a.eng;
+
+    static int xs[NPOINTS], ys[NPOINTS];
+    srand(1);
+    for (int i = 0; i < NPOINTS; i++) {
+        xs[i] = a.x_min + rand() % (a.x_max - a.x_min + 1);
+        ys[i] = a.y_min + rand() % (a.y_max - a.y_min + 1);
+    }
+    // 回転中の軌跡 (update_xy_* 用): 外周を少しずつ回る
+    static int cx[NPOINTS], cy[NPOINTS];
+    for (int i = 0; i < NPOINTS; i++) {
+        double th = i * 0.05;
+        cx[i] = (a.x_min + a.x_max) / 2 + (int)((a.x_max - a.x_min) * 0.45 * cos(th));
+        cy[i] = (a.y_min + a.y_max) / 2 + (int)((a.y_max - a.y_min) * 0.45 * sin(th));
+    }
+
+    double t0, t1;
+    long acc = 0;
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) acc += geom_angle(&e->geom, xs[i], ys[i]);
+    t1 = now_ns();
+    printf("to_ang_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < NPOINTS; i++) acc += geom_in_ring(&e->geom, xs[i], ys[i]);
+    t1 = now_ns();
+    printf("is_in_touch_area_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 1; i < NPOINTS; i++) acc += geom_ang_diff((geom_ang_t)(xs[i] * 53), (geom_ang_t)(ys[i - 1] * 97));
+    t1 = now_ns();
+    printf("angle_diff_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    // 開始判定中: 閾値を超えないよう毎回リセットして in-area の計算経路を通す
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < NPOINTS; i++) {
+            e->staying_in_area = true;
+            e->scrolling = false;
+            e->accum_angle = 0;
+            update_xy_before_scroll(e, cx[i], cy[i], 0);
+        }
+    }
+    t1 = now_ns();
+    printf("update_xy_before_scroll_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+
+    // エンジンのステップ計算と、跨いだときの REL_WHEEL 出力まで
+    e->last_angle = geom_angle(&e->geom, cx[0], cy[0]);
+    e->accum_angle = 0;
+    unsigned long allocs0 = allocs;
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < NPOINTS; i++) {
+            int32_t actual, hires = 0;
+            int32_t steps = update_xy_while_scroll(e, cx[i], cy[i], 0, &actual, &hires);
+            if (steps != 0 || hires != 0) emit_wheel(&a, steps, hires);
+        }
+    }
+    t1 = now_ns();
+    printf("update_xy_while_scroll_ns=%.2f\n", (t1 - t0) / ((double)ROUNDS * NPOINTS));
+    printf("update_xy_while_scroll_wheel_frames=%lu\n", stats.wheel_frames);
+    printf("update_xy_while_scroll_allocs=%lu\n", allocs - allocs0);
+    sink_close(a.mouse_out);
+
+    /* ---- end-to-end ---- */
+    bench_e2e("e2e", &s, 0);
+    bench_e2e("e2e_catchup", &s, DEFAULT_CATCHUP_FRAMES);
+
+    bench_sink = acc;
+    free(s.evs);
+    return 0;
+}
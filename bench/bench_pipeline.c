@@ -0,0 +1,158 @@
+/*
+ * 単一スレッドのループと pipeline (読み取り/ジェスチャの2スレッド) で
+ * passthrough の遅延を比べる。
+ *
+ * イベント列 (録画ファイル、無ければ合成) を等速で drain_events() に流し、
+ * デーモンと同じ handle_event → passthrough_event / gesture_event を通す。
+ * 遅延は ev.time (届くはずだった時刻) から passthrough を書き終えるまで。
+ * スクロール出力はたまに遅くなる (uinput の write が詰まる等) ものとして、
+ * マウス側の sink は STALL_EVERY 回毎の write で STALL_NS だけ止まる。
+ * 単一スレッドではその間に届いたフレームの passthrough が待たされる。
+ *
+ * static 関数を直接呼ぶため wcircle.c と engine.c をそのまま取り込む。
+ */
+#define main wcircle_main
+#include "../wcircle/wcircle.c"
+#undef main
+#include "../wcircle/engine.c"
+
+// 外周を半周回してから内側へ抜ける (スクロールの直後に passthrough が再開する) とタップの繰り返し
+#define SYNTH_SPEC  "rate=1000,pattern=exit+tap,count=12,gap=50,seed=1"
+#define STALL_EVERY 6
+#define STALL_NS    4000000LL
+
+/* ---- 詰まるマウス出力 ---- */
+
+// 詰まるのは write() でブロックしている間なので CPU は使わない
+static int slow_write(sink_t *s, const struct input_event *evs, size_t n){
+    (void)evs; (void)n;
+    if (atomic_load_explicit(&s->writes, memory_order_relaxed) % STALL_EVERY == 0) {
+        struct timespec ts = { 0, STALL_NS };
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+            ;
+    }
+    return 0;
+}
+
+static void slow_close(sink_t *s){
+    free(s);
+}
+
+static const sink_ops_t slow_ops = { "slow", slow_write, slow_close };
+
+static sink_t *slow_sink_new(void){
+    sink_t *s = calloc(1, sizeof(*s));
+    if (!s) DIE("out of memory");
+    s->ops = &slow_ops;
+    return s;
+}
+
+/* ---- イベント列 (等速) ---- */
+
+typedef struct {
+    const char *path;   // NULL なら合成
+    replay_t rp;
+    synth_t g;
+} stream_t;
+
+static void stream_open(stream_t *s, struct input_absinfo *xi, struct input_absinfo *yi){
+    if (s->path) {
+        int rc = replay_open(&s->rp, s->path, true);
+        if (rc < 0) DIE("open replay file '%s': %s", s->path, strerror(-rc));
+        *xi = s->rp.hdr.abs_x;
+        *yi = s->rp.hdr.abs_y;
+    } else {
+        synth_config_t sc;
+        if (synth_parse(&sc, SYNTH_SPEC) < 0) DIE("Invalid synth spec '%s'", SYNTH_SPEC);
+        synth_init(&s->g, &sc, true);
+        *xi = sc.abs_x;
+        *yi = sc.abs_y;
+    }
+}
+
+static void stream_close(stream_t *s){
+    if (s->path) replay_close(&s->rp);
+}
+
+static int stream_next_event(void *src, unsigned int flags, struct input_event *ev){
+    stream_t *s = src;
+    return s->path ? replay_next_event(&s->rp, flags, ev) : synth_next_event(&s->g, flags, ev);
+}
+
+static void bench_config(config_t *cfg, bool pipeline){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->outer_ratio_min = 0.70;
+    cfg->outer_ratio_max = 1.415;
+    cfg->start_arc_rad   = 5.0*DEG2RAD;
+    cfg->step_rad        = 18.0*DEG2RAD;
+    cfg->wheel_step      = 1;
+    cfg->filter_beta     = 20.0;
+    cfg->log_level       = LOG_LVL_INFO;
+    cfg->pipeline        = pipeline;
+    cfg->pipeline_ring   = DEFAULT_PIPELINE_RING;
+    cfg->catchup_frames  = DEFAULT_CATCHUP_FRAMES;
+}
+
+static void report_hist(const char *mode, const char *name, const hist_t *h){
+    printf("%s%s_p50_us=%.1f\n", mode, name, hist_percentile(h, 0.50) / 1e3);
+    printf("%s%s_p99_us=%.1f\n", mode, name, hist_percentile(h, 0.99) / 1e3);
+    printf("%s%s_p999_us=%.1f\n", mode, name, hist_percentile(h, 0.999) / 1e3);
+    printf("%s%s_max_us=%.1f\n", mode, name, h->max / 1e3);
+}
+
+// run_offline と同じ流れで1回流し、passthrough とスクロールの遅延を出す
+static void bench_mode(const char *mode, const char *path, bool pipeline){
+    app_t a;
+    stats_t stats;
+    stream_t s = { .path = path };
+    struct input_absinfo xi, yi;
+    memset(&a, 0, sizeof(a));
+    bench_config(&a.cfg, pipeline);
+    stream_open(&s, &xi, &yi);
+    init_app(&a, &xi, &yi);
+    stats_init(&stats, true);
+    a.stats = &stats;
+    a.pad_out = sink_null_new();
+    if (!a.pad_out) DIE("out of memory");
+    a.mouse_out = slow_sink_new();
+
+    // デーモンと同じく、キューが満杯なら位置だけのフレームは捨てる
+    pipeline_t pl = {0};
+    if (pipeline) {
+        int rc = pipeline_start(&pl, a.cfg.pipeline_ring, false, replay_gesture_frame, &a);
+        if (rc < 0) DIE("Failed to start gesture thread: %s", strerror(-rc));
+        a.pipe = &pl;
+    }
+    int rc;
+    while ((rc = drain_events(&a, stream_next_event, &s)) == 0)
+        ;
+    if (rc != -ENODATA) DIE("%s stream stopped: rc=%d", mode, rc);
+    if (a.pipe && a.pending.n > 0) pipeline_push(&pl, &a.pending, true);
+    pipeline_quiesce(&pl);
+
+    report_hist(mode, "", &stats.passthrough_ns);
+    report_hist(mode, "_scroll", &stats.scroll_ns);
+    printf("%s_pass_frames=%lu\n", mode, stats.pass_frames);
+    printf("%s_wheel_frames=%lu\n", mode, stats.wheel_frames);
+    if (pipeline) {
+        printf("pipeline_frames=%lu\n", pl.pushed);
+        printf("pipeline_depth_max=%lu\n", pl.max_depth);
+        printf("pipeline_overflow=%lu\n", pl.overflow);
+        printf("pipeline_stalls=%lu\n", pl.stalls);
+    }
+    pipeline_stop(&pl);
+    sink_close(a.pad_out);
+    sink_close(a.mouse_out);
+    stream_close(&s);
+}
+
+int main(int argc, char **argv){
+    const char *path = argc > 1 ? argv[1] : NULL;
+    printf("pipeline_bench_stream=%s\n", path ? path : "synthetic");
+    printf("pipeline_bench_stall_every=%d\n", STALL_EVERY);
+    printf("pipeline_bench_stall_us=%lld\n", STALL_NS / 1000);
+    bench_mode("single", path, false);
+    bench_mode("pipeline", path, true);
+    log_flush();
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * 低遅延モード (rt_mode) の有無で、周期的に届くフレームを拾うまでの遅延を比べる。
+ *
+ * フレームは一定周期で届いたものとし、届くはずの時刻まで寝て、起きて処理に
+ * 入るまでを測る (実デバイスでは epoll_wait から戻るまで)。同じ CPU で
+ * SCHED_OTHER の CPU 負荷を HOGS 本回しておき、rt_apply() の前後で同じ測定をする。
+ * 権限が無く SCHED_FIFO にできなかったときは rt_policy=other と出る。
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../wcircle/log.h"
+#include "../wcircle/rt.h"
+#include "../wcircle/stats.h"
+
+#define NFRAMES   4000
+#define PERIOD_NS 1000000LL   // 1 kHz
+#define HOGS      2
+#define BENCH_CPU 0
+
+static atomic_bool stop;
+
+static void sleep_until(int64_t t){
+    struct timespec ts = { t / 1000000000, t % 1000000000 };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void pin(pthread_t thread){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(BENCH_CPU, &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+// 同じ CPU を取り合う通常のプロセスの代わり
+static void *hog_main(void *arg){
+    (void)arg;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) { }
+    return NULL;
+}
+
+static void measure(hist_t *h){
+    int64_t t0 = stats_now_ns() + 1000000;
+    for (uint32_t i = 0; i < NFRAMES; i++) {
+        int64_t arrival = t0 + (int64_t)i * PERIOD_NS;
+        sleep_until(arrival);
+        hist_record(h, (uint64_t)(stats_now_ns() - arrival));
+    }
+}
+
+static void report(const char *mode, const hist_t *h){
+    printf("%s_p50_us=%.1f\n", mode, hist_percentile(h, 0.50) / 1e3);
+    printf("%s_p99_us=%.1f\n", mode, hist_percentile(h, 0.99) / 1e3);
+    printf("%s_p999_us=%.1f\n", mode, hist_percentile(h, 0.999) / 1e3);
+    printf("%s_max_us=%.1f\n", mode, h->max / 1e3);
+}
+
+int main(void){
+    static hist_t off, on;
+    pthread_t hogs[HOGS];
+
+    pin(pthread_self());
+    for (int i = 0; i < HOGS; i++) {
+        if (pthread_create(&hogs[i], NULL, hog_main, NULL) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+        pin(hogs[i]);
+    }
+
+    measure(&off);
+    rt_config_t cfg = { .priority = 50, .cpu = BENCH_CPU, .prefault_kb = 256 };
+    rt_status_t st;
+    rt_apply(&cfg, &st);
+    measure(&on);
+
+    atomic_store(&stop, true);
+    for (int i = 0; i < HOGS; i++) pthread_join(hogs[i], NULL);
+
+    printf("rt_bench_frames=%d\n", NFRAMES);
+    printf("rt_bench_period_us=%lld\n", PERIOD_NS / 1000);
+    printf("rt_bench_hogs=%d\n", HOGS);
+    report("rt_off", &off);
+    report("rt_on", &on);
+    char buf[512];
+    fwrite(buf, 1, rt_format(&st, buf, sizeof(buf)), stdout);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#!/bin/sh
+# make check: 合成入力と録画を wcircle.bin に通し、ホイールの出力と統計を確かめる
+#   sh tests/check.sh [wcircle.bin]
+set -u
+
+BIN=${1:-./wcircle.bin}
+TESTS=$(dirname "$0")
+. "$TESTS/lib.sh"
+
+# expect WHAT GOT WANT
+expect(){
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1: $2"
+    else
+        echo "FAIL $1: got '$2', want '$3'"
+        failed=1
+    fi
+}
+
+# near WHAT GOT WANT PERCENT: "合計 絶対値" の組がどちらも PERCENT % 以内
+near(){
+    if echo "$2 $3" | awk -v p="$4" '{
+            for (i = 1; i <= 2; i++) {
+                d = $i - $(i + 2)
+                if (d < 0) d = -d
+                if (d * 100 > p * ($(i + 2) < 0 ? -$(i + 2) : $(i + 2))) exit 1
+            } }'; then
+        echo "ok   $1: $2 (want $3 +-$4%)"
+    else
+        echo "FAIL $1: got '$2', want '$3' +-$4%"
+        failed=1
+    fi
+}
+
+# ---- 追いつき (catch-up) ----
+# 位置だけのフレームをまとめても、出るホイールの量は1フレームずつ処理したときと同じ。
+# 加速は角速度で倍率が変わるので、まとめたフレームでも角速度が保たれていれば 1% 以内に収まる
+SPIN=rate=125,speed=1.5
+for s in "" "predict_ms=20" "kinetic_ms=300"; do
+    if run cu_off "catchup_frames=0;$s" --synth $SPIN && run cu_on "catchup_frames=8;$s" --synth $SPIN; then
+        expect "catch-up on/off${s:+ ($s)}" "$(wheel cu_on)" "$(wheel cu_off)"
+    fi
+done
+if run cu_off "catchup_frames=0;accel=fast" --synth $SPIN && run cu_on "catchup_frames=8;accel=fast" --synth $SPIN; then
+    [ "$(stat cu_on coalesced_frames)" -gt 0 ] || { echo "FAIL catch-up: no frames were coalesced"; failed=1; }
+    near "catch-up on/off (accel=fast)" "$(wheel cu_on)" "$(wheel cu_off)" 1
+fi
+
+# ---- 2本目の指 (multi_touch) ----
+# two は spin の途中だけ2本目の指を置く。1本目の軌跡は spin と同じなので、
+# ignore ではそのまま spin と同じだけ出る。cancel では two の後半が出ず、次の spin は普通に出る
+if run mt_ref "catchup_frames=0;multi_touch=ignore" --synth count=4,pattern=spin+spin &&
+   run mt_ignore "catchup_frames=0;multi_touch=ignore" --synth count=4,pattern=two+spin &&
+   run mt_cancel "catchup_frames=0;multi_touch=cancel" --synth count=4,pattern=two+spin; then
+    expect "multi_touch=ignore: wheel" "$(wheel mt_ignore)" "$(wheel mt_ref)"
+    [ "$(stat mt_ignore mt_extra_frames)" -gt 0 ] || { echo "FAIL multi_touch=ignore: no extra contact seen"; failed=1; }
+    expect "multi_touch=cancel: cancels" "$(stat mt_cancel mt_cancels)" 2
+    # 2回の spin (ref の半分) より多く、ref より少ない
+    if wheel mt_cancel | awk -v ref="$(wheel mt_ref | cut -d' ' -f2)" '{ exit !($2 > ref / 2 && $2 < ref) }'; then
+        echo "ok   multi_touch=cancel: wheel $(wheel mt_cancel) (ref $(wheel mt_ref))"
+    else
+        echo "FAIL multi_touch=cancel: wheel $(wheel mt_cancel), want between half and all of ref $(wheel mt_ref)"
+        failed=1
+    fi
+fi
+
+# ---- SYN_DROPPED (tests/syn_dropped.wcrec, tests/gen_syn_dropped.py で作成) ----
+# 1回目は回転中に欠落して指が 2 rad 先へ飛ぶ: 飛んだ分は出さず、続きはそのままスクロールする。
+# 2回目は欠落中に指を離している: 離したことになり、最後は触れていない状態で終わる。
+# 飛んだ分まで出すと 34 になり、離したのを見落とすと scrolling 1 で終わる
+for s in "catchup_frames=0" "catchup_frames=8" "pipeline=1"; do
+    if run drop "$s" --replay "$TESTS/syn_dropped.wcrec"; then
+        expect "SYN_DROPPED ($s): wheel" "$(wheel drop)" "-27 27"
+        expect "SYN_DROPPED ($s): resyncs" "$(stat drop resyncs)" 2
+        expect "SYN_DROPPED ($s): final state" "$(stat drop engine_state) $(stat drop engine_touch)" "first 0"
+    fi
+done
+
+[ $failed -eq 0 ] && echo "all checks passed"
+exit $failed
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+# tests/syn_dropped.wcrec を作る: python3 tests/gen_syn_dropped.py tests/syn_dropped.wcrec
+#   1. 外周を回している途中で SYN_DROPPED。指は置いたまま 2 rad 先へ飛び、そのまま回して離す
+#   2. もう一度回している途中で SYN_DROPPED。その間に指を離している
+import math
+import struct
+import sys
+
+EV_SYN, EV_KEY, EV_ABS = 0, 1, 3
+SYN_REPORT, SYN_DROPPED = 0, 3
+BTN_TOUCH = 330
+ABS_X, ABS_Y = 0, 1
+STEP = 0.1         # 1フレームの回転 [rad]
+PERIOD = 8000      # フレーム間隔 [us]
+
+out = open(sys.argv[1], 'wb')
+absinfo = struct.pack('<6i', 0, 0, 1000, 0, 0, 10)   # value, min, max, fuzz, flat, resolution
+out.write(b'WCRC' + struct.pack('<I', 1) + absinfo + absinfo)
+t = 1000000
+
+
+def ev(ty, code, value):
+    out.write(struct.pack('<qHHi', t, ty, code, value))
+
+
+def frame(a, touch=None, syn_dropped=False):
+    global t
+    if syn_dropped:
+        ev(EV_SYN, SYN_DROPPED, 0)   # ここから SYN_REPORT までが libevdev の同期イベント列
+    if touch is not None:
+        ev(EV_KEY, BTN_TOUCH, touch)
+    if a is not None:
+        ev(EV_ABS, ABS_X, int(500 + 450 * math.cos(a)))
+        ev(EV_ABS, ABS_Y, int(500 + 450 * math.sin(a)))
+    ev(EV_SYN, SYN_REPORT, 0)
+    t += PERIOD
+
+
+for i in range(30):
+    frame(i * STEP, 1 if i == 0 else None)
+frame(50 * STEP, syn_dropped=True)
+for i in range(51, 80):
+    frame(i * STEP)
+frame(None, 0)
+t += 200000
+
+for i in range(30):
+    frame(i * STEP, 1 if i == 0 else None)
+frame(None, 0, syn_dropped=True)
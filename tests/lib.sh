@@ -0,0 +1,31 @@
+# tests/check.sh と tests/measure.sh の共通部分 (BIN を決めてから . で読む)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failed=0
+
+# run NAME SETTINGS ARGS...
+# SETTINGS ("key=value;...") だけを設定にして実行し、mouse sink を $TMP/NAME.wcrec、
+# 標準出力/エラー (統計) を $TMP/NAME.txt に残す
+run(){
+    name=$1 settings=$2
+    shift 2
+    { echo "[wcircle]"; echo "$settings" | tr ';' '\n'; } > "$TMP/$name.ini"
+    if ! "$BIN" --config "$TMP/$name.ini" "$@" --mouse-sink "file:$TMP/$name.wcrec" > "$TMP/$name.txt" 2>&1; then
+        echo "FAIL $name: wcircle exited with an error"
+        cat "$TMP/$name.txt"
+        failed=1
+        return 1
+    fi
+}
+
+# REL_WHEEL の合計と絶対値の合計 (録画は 56 バイトのヘッダの後に 16 バイトずつ:
+# 時刻 int64, type/code u16, value int32。type=EV_REL(2), code=REL_WHEEL(8))
+wheel(){
+    od -A n -t d4 -j 56 -w16 -v "$TMP/$1.wcrec" |
+        awk '$3 == 2 + 8 * 65536 { s += $4; a += $4 < 0 ? -$4 : $4 } END { print s + 0, a + 0 }'
+}
+
+# 統計の値 (key=value)
+stat(){
+    sed -n "s/^$2=//p" "$TMP/$1.txt" | head -n 1
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# コミットメッセージや README に書いた数値を再現する (make measure)。結果は key=value
+#   sh tests/measure.sh [名前...]    名前を省くと全部
+# wcircle.bin は WCIRCLE_BIN (既定 ./wcircle.bin)
+set -u
+
+BIN=${WCIRCLE_BIN:-./wcircle.bin}
+TESTS=$(dirname "$0")
+. "$TESTS/lib.sh"
+
+# passthrough: フレーム単位の write。1イベント1回の write だった頃の回数は pad_sink_events と同じ
+measure_passthrough(){
+    spec=count=6
+    run pass "catchup_frames=0" --synth $spec || return
+    echo "passthrough_synth=$spec"
+    echo "passthrough_events=$(stat pass events)"
+    echo "passthrough_pad_events=$(stat pass pad_sink_events)"
+    echo "passthrough_writes=$(stat pass passthrough_frames)"
+}
+
+# predict: predict_ms=0 と 30 で、触れてから最初のスクロールまでと各ステップの先行
+measure_predict(){
+    spec=count=20
+    for p in 0 30; do
+        run pred$p "catchup_frames=0;predict_ms=$p" --synth $spec || return
+    done
+    echo "predict_synth=$spec"
+    for p in 0 30; do
+        echo "predict_${p}ms_time_to_first_scroll_p50_us=$(stat pred$p time_to_first_scroll_p50_us)"
+        echo "predict_${p}ms_step_lead_p50_us=$(stat pred$p step_lead_p50_us)"
+        echo "predict_${p}ms_step_lag_count=$(stat pred$p step_lag_count)"
+        echo "predict_${p}ms_corrections=$(stat pred$p predict_corrections)"
+        echo "predict_${p}ms_wheel=$(wheel pred$p)"
+    done
+}
+
+# jitter: 揺らぎの大きいゆっくりした回転を細かいステップ (step_rad=3、単位は度) で。
+# フィルタ/ヒステリシスなしと、それぞれを入れたときの逆転回数と最初のスクロールまで
+measure_jitter(){
+    spec=count=10,pattern=spin,jitter=0.01,speed=0.3,rate=125
+    i=0
+    for s in "" "filter_min_cutoff=2" "reverse_deg=3"; do
+        run jit$i "catchup_frames=0;step_rad=3;$s" --synth $spec || return
+        i=$((i + 1))
+    done
+    echo "jitter_synth=$spec"
+    i=0
+    for name in off filter reverse; do
+        echo "jitter_${name}_wheel_reversals=$(stat jit$i wheel_reversals)"
+        echo "jitter_${name}_time_to_first_scroll_p50_us=$(stat jit$i time_to_first_scroll_p50_us)"
+        echo "jitter_${name}_wheel=$(wheel jit$i)"
+        i=$((i + 1))
+    done
+}
+
+names=${*:-passthrough predict jitter}
+for n in $names; do
+    case $n in
+    passthrough) measure_passthrough ;;
+    predict) measure_predict ;;
+    jitter) measure_jitter ;;
+    *) echo "unknown measurement '$n'" >&2; exit 1 ;;
+    esac
+done
+exit $failed
@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+#include "discover.h"
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+
+static int read_line(const char *path, char *buf, size_t len)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -errno;
+    if (!fgets(buf, (int)len, fp)) {
+        fclose(fp);
+        return -EIO;
+    }
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static const char *node_name(const char *devnode)
+{
+    const char *base = strrchr(devnode, '/');
+    return base ? base + 1 : devnode;
+}
+
+// capabilities/abs は上位ワードから空白区切りの16進
+static bool abs_bits_set(const char *line, const int *codes, int ncodes)
+{
+    unsigned long words[8] = { 0 };
+    int n = 0;
+    char copy[256], *save = NULL;
+    snprintf(copy, sizeof(copy), "%s", line);
+    for (char *tok = strtok_r(copy, " ", &save); tok && n < 8; tok = strtok_r(NULL, " ", &save))
+        words[n++] = strtoul(tok, NULL, 16);
+
+    for (int i = 0; i < ncodes; i++) {
+        int w = codes[i] / (int)BITS_PER_LONG, b = codes[i] % (int)BITS_PER_LONG;
+        if (w >= n || !(words[n - 1 - w] & (1UL << b))) return false;
+    }
+    return true;
+}
+
+bool discover_is_touchpad(const char *devnode)
+{
+    static const int need[] = { ABS_X, ABS_Y, ABS_MT_POSITION_X, ABS_MT_POSITION_Y };
+    const char *ev = node_name(devnode);
+    char path[PATH_MAX], real[PATH_MAX], line[256];
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device", ev);
+    if (!realpath(path, real) || strstr(real, "/devices/virtual/")) return false;
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/capabilities/abs", ev);
+    if (read_line(path, line, sizeof(line)) < 0) return false;
+    return abs_bits_set(line, need, sizeof(need) / sizeof(need[0]));
+}
+
+int discover_read_identity(const char *devnode, pad_info_t *info)
+{
+    const char *ev = node_name(devnode);
+    char path[PATH_MAX], line[256];
+    int rc;
+
+    memset(info, 0, sizeof(*info));
+    snprintf(info->path, sizeof(info->path), "%s", devnode);
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/name", ev);
+    if ((rc = read_line(path, info->name, sizeof(info->name))) < 0) return rc;
+
+    static const char *const ids[] = { "bustype", "vendor", "product" };
+    unsigned *vals[] = { &info->bustype, &info->vendor, &info->product };
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "/sys/class/input/%s/device/id/%s", ev, ids[i]);
+        if ((rc = read_line(path, line, sizeof(line))) < 0) return rc;
+        *vals[i] = (unsigned)strtoul(line, NULL, 16);
+    }
+    return 0;
+}
+
+static int cmp_info(const void *a, const void *b)
+{
+    return strverscmp(((const pad_info_t *)a)->path, ((const pad_info_t *)b)->path);
+}
+
+int discover_touchpads(pad_info_t *out, int max)
+{
+    DIR *dir = opendir("/sys/class/input");
+    if (!dir) return -errno;
+
+    struct dirent *de;
+    int n = 0;
+    while (n < max && (de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "event", 5) != 0) continue;
+
+        char devnode[PATH_MAX];
+        snprintf(devnode, sizeof(devnode), "/dev/input/%s", de->d_name);
+        if (!discover_is_touchpad(devnode)) continue;
+        if (discover_read_identity(devnode, &out[n]) == 0) n++;
+    }
+    closedir(dir);
+    qsort(out, n, sizeof(out[0]), cmp_info);
+    return n;
+}
+
+int devcache_load(const char *file, pad_info_t *out, int max)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) return -errno;
+
+    char line[512];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), fp)) {
+        pad_info_t *p = &out[n];
+        int off = 0;
+        memset(p, 0, sizeof(*p));
+        if (sscanf(line, "%255s %x:%x:%x %n", p->path, &p->bustype, &p->vendor,
+                   &p->product, &off) != 4 || off == 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(p->name, sizeof(p->name), "%s", line + off);
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+int devcache_save(const char *file, const pad_info_t *pads, int n)
+{
+    char tmp[PATH_MAX], dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", file);
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+
+    // 途中で落ちても壊れたキャッシュを残さないよう rename で置き換える
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return -errno;
+    for (int i = 0; i < n; i++)
+        fprintf(fp, "%s %04x:%04x:%04x %s\n", pads[i].path, pads[i].bustype,
+                pads[i].vendor, pads[i].product, pads[i].name);
+    if (fclose(fp) != 0 || rename(tmp, file) != 0) {
+        int err = errno;
+        unlink(tmp);
+        return -err;
+    }
+    return 0;
+}
+
+bool devcache_valid(const pad_info_t *cached)
+{
+    pad_info_t now;
+    if (discover_read_identity(cached->path, &now) < 0) return false;
+    return now.bustype == cached->bustype && now.vendor == cached->vendor &&
+           now.product == cached->product && strcmp(now.name, cached->name) == 0;
+}
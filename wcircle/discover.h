@@ -0,0 +1,34 @@
+#ifndef WCIRCLE_DISCOVER_H
+#define WCIRCLE_DISCOVER_H
+
+#include <stdbool.h>
+
+/*
+ * /sys/class/input の capabilities/abs ビットマップからタッチパッドを探す。
+ * デバイスノードは開かない。仮想デバイス (uinput 等) は対象外。
+ */
+
+typedef struct {
+    char path[256];             // /dev/input/eventN
+    char name[128];
+    unsigned bustype, vendor, product;
+} pad_info_t;
+
+/* eventN が ABS_MT_POSITION_X/Y を持つ物理デバイスか (sysfs のみで判定) */
+bool discover_is_touchpad(const char *devnode);
+/* 名前と ID を sysfs から読む。失敗で -errno */
+int  discover_read_identity(const char *devnode, pad_info_t *info);
+/* タッチパッドを最大 max 個列挙する (番号順)。sysfs が読めなければ -errno */
+int  discover_touchpads(pad_info_t *out, int max);
+
+/*
+ * 前回選んだデバイスのキャッシュ。1行1台:
+ *   <path> <bus>:<vendor>:<product> <name>
+ * absinfo は持たない (libevdev が開くときに全軸を読み直すので省けない)
+ */
+int  devcache_load(const char *file, pad_info_t *out, int max);
+int  devcache_save(const char *file, const pad_info_t *pads, int n);
+/* キャッシュの path が今も同じデバイスを指しているか */
+bool devcache_valid(const pad_info_t *cached);
+
+#endif /* WCIRCLE_DISCOVER_H */
@@ -0,0 +1,532 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/input-event-codes.h>
+#include "engine.h"
+
+#define VELOCITY_TAU_US 16000   // 角速度の平滑化の時定数
+#define VELOCITY_GAP_US 100000  // これ以上空いたら角速度を捨てる
+#define KINETIC_WINDOW_US 50000 // 離した時の角速度はこの時間内のフレームから求める
+#define KINETIC_MASK (ENGINE_KINETIC_SAMPLES - 1)
+#define FILTER_D_CUTOFF 1.0f    // One-Euro: 速度の平滑化の遮断周波数 [Hz]
+
+/*
+ * 加速カーブを段ごとの倍率の表にする。フレームごとの計算は表引き1回で済む。
+ * 点は角速度の昇順。最初の点より遅ければ最初の倍率、最後の点より速ければ最後の倍率。
+ */
+static void accel_init(engine_t *e, const engine_config_t *cfg)
+{
+    int n = cfg->accel_points < ENGINE_ACCEL_POINTS ? cfg->accel_points : ENGINE_ACCEL_POINTS;
+    for (int b = 0; b < ENGINE_ACCEL_BUCKETS; b++) {
+        double dps = (b + 0.5) * ENGINE_ACCEL_BUCKET_DPS;
+        double gain = cfg->accel_gain[n - 1];
+        if (dps <= cfg->accel_dps[0]) {
+            gain = cfg->accel_gain[0];
+        } else {
+            for (int i = 1; i < n; i++) {
+                if (dps > cfg->accel_dps[i]) continue;
+                double span = cfg->accel_dps[i] - cfg->accel_dps[i - 1];
+                double r = span > 0 ? (dps - cfg->accel_dps[i - 1]) / span : 1;
+                gain = cfg->accel_gain[i - 1] + r * (cfg->accel_gain[i] - cfg->accel_gain[i - 1]);
+                break;
+            }
+        }
+        long q = lround(gain * ENGINE_ACCEL_ONE);
+        e->accel_lut[b] = q < 0 ? 0 : q > ENGINE_ACCEL_MAX ? ENGINE_ACCEL_MAX : (uint16_t)q;
+    }
+    e->accel_scale = (float)(1e6 * 360.0 / GEOM_ANG_TURN / ENGINE_ACCEL_BUCKET_DPS);
+    e->accel = true;
+}
+
+void engine_init(engine_t *e, const engine_config_t *cfg)
+{
+    memset(e, 0, sizeof(*e));
+    e->state = ENGINE_NONE;
+    geom_init(&e->geom, cfg->x_min, cfg->x_max, cfg->y_min, cfg->y_max,
+              cfg->outer_ratio_min, cfg->outer_ratio_max);
+    e->start_arc_ang = geom_rad_to_ang(cfg->start_arc_rad);
+    e->step_ang = geom_rad_to_ang(cfg->step_rad);
+    if (e->step_ang < 1) e->step_ang = 1;
+    e->all_wheel = cfg->all_wheel;
+    e->invert = cfg->invert;
+    e->predict_us = cfg->predict_us > 0 ? cfg->predict_us : 0;
+    e->hi_res = cfg->hi_res;
+    e->accel_q = ENGINE_ACCEL_ONE;
+    if (cfg->kinetic_tau_us > 0) {
+        e->kinetic_tau_us = cfg->kinetic_tau_us;
+        e->kinetic_tick_us = cfg->kinetic_tick_us > 0 ? cfg->kinetic_tick_us : 16000;
+        e->kinetic_min = (float)(cfg->kinetic_min_rad_s / (2 * M_PI) * GEOM_ANG_TURN / 1e6);
+    }
+    if (cfg->accel_points > 0) accel_init(e, cfg);
+    if (cfg->filter_min_cutoff > 0) {
+        e->filter = true;
+        e->filter_min_cutoff = (float)cfg->filter_min_cutoff;
+        e->filter_beta = (float)(cfg->filter_beta > 0 ? cfg->filter_beta : 0);
+        e->filter_sx = cfg->x_max > cfg->x_min ? 2.0f / (float)(cfg->x_max - cfg->x_min) : 1.0f;
+        e->filter_sy = cfg->y_max > cfg->y_min ? 2.0f / (float)(cfg->y_max - cfg->y_min) : 1.0f;
+    }
+    if (cfg->reverse_rad > 0) e->reverse_ang = geom_rad_to_ang(cfg->reverse_rad);
+    e->mt_mode = cfg->multi_touch;
+    for (int i = 0; i < ENGINE_MT_SLOTS; i++) e->mt.id[i] = -1;
+    e->mt.bound = -1;
+}
+
+void engine_mt_event(engine_t *e, uint16_t code, int32_t value)
+{
+    engine_mt_t *m = &e->mt;
+    if (e->mt_mode == ENGINE_MT_OFF) return;
+    if (code == ABS_MT_SLOT) {
+        m->slot = value;
+        return;
+    }
+    if ((uint32_t)m->slot >= ENGINE_MT_SLOTS) return;
+    switch (code) {
+    case ABS_MT_TRACKING_ID:
+        m->id[m->slot] = value;
+        if (value >= 0) m->active |= 1u << m->slot;
+        else m->active &= ~(1u << m->slot);
+        m->seen = true;
+        break;
+    case ABS_MT_POSITION_X: m->x[m->slot] = value; m->seen = true; break;
+    case ABS_MT_POSITION_Y: m->y[m->slot] = value; m->seen = true; break;
+    default: break;
+    }
+}
+
+/*
+ * BTN_TOUCH の代わりに、ジェスチャを始めた指 (bound) の出入りで ENGINE_TOUCH_* を作り、
+ * 位置もその指のものにする。2本目の指で ABS_X/ABS_Y が飛んでも角度は飛ばない。
+ *   bound の指が離れた (同じスロットが別の指になった) -> 離したのと同じ。
+ *     他の指が残っていれば、全部離れるまで次のジェスチャを始めない (残った指への乗り換えで角度が飛ぶため)
+ *   他の指も触れている -> ENGINE_MT_CANCEL なら離したのと同じ (慣性は始めない)、IGNORE なら無視
+ */
+static void mt_bind(engine_t *e, engine_frame_t *f, engine_result_t *out)
+{
+    engine_mt_t *m = &e->mt;
+    uint32_t flags = f->flags & ~(ENGINE_TOUCH_DOWN | ENGINE_TOUCH_UP | ENGINE_NEW_CONTACT);
+
+    if (m->bound >= 0 && m->id[m->bound] != m->bound_id) {
+        flags |= ENGINE_TOUCH_UP;
+        m->bound = -1;
+        m->waiting = m->active != 0;
+    } else if (m->bound >= 0 && (m->active & ~(1u << m->bound))) {
+        out->extra_contact = true;
+        if (e->mt_mode == ENGINE_MT_CANCEL) {
+            flags |= ENGINE_TOUCH_UP;
+            m->bound = -1;
+            m->waiting = true;
+            out->cancelled = true;
+        }
+    }
+    if (m->active == 0) m->waiting = false;
+    if (m->bound < 0 && !m->waiting && m->active) {
+        m->bound = __builtin_ctz(m->active);
+        m->bound_id = m->id[m->bound];
+        flags |= ENGINE_TOUCH_DOWN | ENGINE_NEW_CONTACT;
+    }
+    if (m->bound >= 0) {
+        f->x = m->x[m->bound];
+        f->y = m->y[m->bound];
+    }
+    f->flags = flags;
+}
+
+// 1次ローパスの係数 (遮断周波数 cutoff [Hz]、間隔 dt [s])
+static inline float lowpass_alpha(float cutoff, float dt)
+{
+    return 1.0f / (1.0f + 1.0f / (2.0f * (float)M_PI * cutoff * dt));
+}
+
+/*
+ * One-Euro フィルタ: 遅い動きは強く平滑化して境界付近の揺れを消し、
+ * 速い動きは遮断周波数を上げてほとんど遅らせない。位置だけを平滑化する (角度は wrap するので)。
+ * 円を描くと片方の軸の速さは周期的に 0 になるので、遮断周波数は2軸の速さの大きさで決める。
+ */
+static void filter_xy(engine_t *e, engine_frame_t *f)
+{
+    float dt = (float)(f->time_us - e->filter_us) * 1e-6f;
+    e->filter_us = f->time_us;
+    if (e->filter_n == 0 || dt > 0.1f) {
+        e->fx = (float)f->x;
+        e->fy = (float)f->y;
+        e->filter_n = 1;
+        return;
+    }
+    if (dt <= 0) dt = 1e-3f;
+    float dx = ((float)f->x - e->fx) / dt, dy = ((float)f->y - e->fy) / dt;
+    if (e->filter_n == 1) {
+        // 最初の速度はそのまま使う (0 から平滑化すると動き出しが遅れる)
+        e->fdx = dx;
+        e->fdy = dy;
+        e->filter_n = 2;
+    } else {
+        float a = lowpass_alpha(FILTER_D_CUTOFF, dt);
+        e->fdx += a * (dx - e->fdx);
+        e->fdy += a * (dy - e->fdy);
+    }
+    float speed = hypotf(e->fdx * e->filter_sx, e->fdy * e->filter_sy);
+    float a = lowpass_alpha(e->filter_min_cutoff + e->filter_beta * speed, dt);
+    e->fx += a * ((float)f->x - e->fx);
+    e->fy += a * ((float)f->y - e->fy);
+    f->x = (int32_t)lrintf(e->fx);
+    f->y = (int32_t)lrintf(e->fy);
+}
+
+/*
+ * スクロール中の逆回転は reverse_ang までは出さずに溜める。
+ * 元の向きに戻れば溜めた分と相殺し、reverse_ang を超えたら超えた分だけ出して向きを変える
+ * (逆転するには step に加えて reverse_ang だけ戻す必要がある。順方向は遅らせない)。
+ */
+static int32_t hysteresis(engine_t *e, int32_t d)
+{
+    if (e->reverse_pending == 0 && (e->dir == 0 || (d > 0) == (e->dir > 0))) {
+        if (d != 0) e->dir = d > 0 ? 1 : -1;
+        return d;
+    }
+    e->reverse_pending += d;
+    if (e->reverse_pending * e->dir > 0) {
+        d = e->reverse_pending;
+        e->reverse_pending = 0;
+        return d;
+    }
+    if (abs(e->reverse_pending) <= e->reverse_ang) return 0;
+    d = e->reverse_pending + e->dir * e->reverse_ang;
+    e->reverse_pending = 0;
+    e->dir = -e->dir;
+    return d;
+}
+
+// 角度の基準を取り直す (接触の開始・同期後)。角速度も捨てる
+static void anchor(engine_t *e, int x, int y, int64_t t)
+{
+    e->last_angle = geom_angle(&e->geom, x, y);
+    e->angle_us = t;
+    e->velocity = 0;
+    e->kin_n = 0;
+}
+
+// スクロール中の回転量に角速度に応じた倍率を掛ける。端数は次のフレームへ持ち越す
+static inline int32_t accelerate(engine_t *e, int32_t d)
+{
+    uint32_t b = (uint32_t)(fabsf(e->velocity) * e->accel_scale);
+    if (b >= ENGINE_ACCEL_BUCKETS) b = ENGINE_ACCEL_BUCKETS - 1;
+    e->accel_q = e->accel_lut[b];
+    int32_t q = d * e->accel_q + e->accel_rem;
+    int32_t out = q / ENGINE_ACCEL_ONE;
+    e->accel_rem = q - out * ENGINE_ACCEL_ONE;
+    return out;
+}
+
+/*
+ * 角度を進めて差分を返す。予測か加速が有効なら角速度も更新する。
+ * 加速はスクロール中だけで、開始判定には指の回転をそのまま使う。
+ */
+static int32_t advance(engine_t *e, int x, int y, int64_t t)
+{
+    geom_ang_t ang = geom_angle(&e->geom, x, y);
+    int32_t d = geom_ang_diff(ang, e->last_angle);
+    e->last_angle = ang;
+    if (e->predict_us || e->accel) {
+        // 途切れは直前に受け取ったフレームから測る (追いつきでまとめたフレームも指は動いている)
+        int64_t dt = t - e->angle_us;
+        if (t - e->prev_us > VELOCITY_GAP_US) {
+            e->velocity = 0;
+        } else if (dt > 0) {
+            float a = (float)dt / (float)(dt + VELOCITY_TAU_US);
+            e->velocity += a * ((float)d / (float)dt - e->velocity);
+        }
+    }
+    if (e->reverse_ang && e->state == ENGINE_SCROLLING) d = hysteresis(e, d);
+    if (e->accel && e->state == ENGINE_SCROLLING) d = accelerate(e, d);
+    e->accum_angle += d;
+    if (e->hi_res) e->hires_accum += d * ENGINE_HIRES_NOTCH;
+    if (e->predict_us) e->actual_angle += d;
+    e->angle_us = t;
+    if (e->kinetic_tau_us) {
+        e->kin_total += (uint32_t)d;
+        e->kin_a[e->kin_head] = e->kin_total;
+        e->kin_t[e->kin_head] = t;
+        e->kin_head = (e->kin_head + 1) & KINETIC_MASK;
+        if (e->kin_n < ENGINE_KINETIC_SAMPLES) e->kin_n++;
+    }
+    return d;
+}
+
+static void update_xy_before_scroll(engine_t *e, int x, int y, int64_t t)
+{
+    advance(e, x, y, t);
+
+    if (!geom_in_ring(&e->geom, x, y)) e->staying_in_area = false;
+    if (e->staying_in_area && abs(e->accum_angle) >= e->start_arc_ang) e->scrolling = true;
+}
+
+// accum を step で割ったステップ数を符号付きで返し、端数を持ち越す
+static int32_t take_steps(int32_t *accum, int32_t lead, int32_t step, bool invert)
+{
+    int steps = abs(*accum + lead) / step;
+    if (steps == 0) return 0;
+
+    int dir = (*accum + lead > 0) ? -1 : 1;
+    *accum += dir * steps * step; // 端数は次のフレームへ持ち越し
+    if (invert) dir = -dir;
+    return dir * steps;
+}
+
+/*
+ * hi_res: 角度を 1/120 ノッチ単位に変換して返し、端数は次のフレームへ持ち越す。
+ * 出した量の累計が ±120 を跨ぐごとに REL_WHEEL のノッチを *notches に作る
+ * (ノッチしか見ないクライアントでも合計が hires と一致する)。
+ */
+static int32_t take_hires(engine_t *e, int32_t lead, int32_t *notches)
+{
+    int32_t units = (e->hires_accum + lead * ENGINE_HIRES_NOTCH) / e->step_ang;
+    e->hires_accum -= units * e->step_ang;
+    if (!e->invert) units = -units;   // 角度が正 = ホイール負 (take_steps と同じ向き)
+
+    e->notch_accum += units;
+    *notches = e->notch_accum / ENGINE_HIRES_NOTCH;
+    e->notch_accum -= *notches * ENGINE_HIRES_NOTCH;
+    return units;
+}
+
+// 予測で半ステップ以上行き過ぎていれば1ステップ戻す。戻したステップ数を返す
+static int32_t retract(engine_t *e, int32_t lead)
+{
+    if (e->lead_dir == 0 || (e->accum_angle + lead) * e->lead_dir >= -e->step_ang / 2) return 0;
+    e->accum_angle += e->lead_dir * e->step_ang;
+    int32_t steps = (e->lead_dir > 0) != e->invert ? 1 : -1;
+    e->lead_dir = 0;
+    return steps;
+}
+
+/*
+ * このフレームで跨いだステップ数を符号付きで返す。
+ * 予測が有効なら、角速度 x predict_us (最大1ステップ) だけ先の角度でステップを出す。
+ * 先に出した分は accum_angle に逆向きの端数として残るので、指が減速・反転すれば
+ * その分だけ次のステップが遅れる。減速して予測を除いても半ステップ以上行き過ぎて
+ * いるときは、1ステップ逆向きに出して戻す (戻した後は1ステップ分の余裕があるので往復しない)。
+ * hi_res では予測位置を連続に追うので、予測が縮めばそのまま逆向きの hires が出る。
+ */
+static int32_t update_xy_while_scroll(engine_t *e, int x, int y, int64_t t, int32_t *actual, int32_t *hires)
+{
+    advance(e, x, y, t);
+
+    int32_t lead = 0;
+    if (e->predict_us) {
+        // 加速中は出力側の角度で先回りする
+        float l = e->velocity * (float)e->predict_us * (float)e->accel_q / ENGINE_ACCEL_ONE;
+        if (l > (float)e->step_ang) l = (float)e->step_ang;
+        if (l < -(float)e->step_ang) l = -(float)e->step_ang;
+        lead = (int32_t)l;
+    }
+    if (e->hi_res) {
+        int32_t notches;
+        *hires = take_hires(e, lead, &notches);
+        e->accum_angle = 0;   // hi_res では hires_accum が端数を持つ
+        *actual = e->predict_us ? take_steps(&e->actual_angle, 0, e->step_ang, e->invert) : notches;
+        return notches;
+    }
+    int32_t steps = take_steps(&e->accum_angle, lead, e->step_ang, e->invert);
+    if (!e->predict_us) {
+        *actual = steps;
+        return steps;
+    }
+    *actual = take_steps(&e->actual_angle, 0, e->step_ang, e->invert);
+
+    if (steps != 0) e->lead_dir = (steps > 0) != e->invert ? -1 : 1;   // 角度の向き
+    else steps = retract(e, lead);
+    return steps;
+}
+
+/*
+ * 指を離した時刻 t に慣性を始める。角速度は最後のフレームから KINETIC_WINDOW_US 以内の
+ * 最も古いフレームとの差で求める (最後のフレームが古ければ指は止まっていたので始めない)。
+ */
+static void kinetic_start(engine_t *e, int64_t t)
+{
+    if (e->kin_n < 2) return;
+    uint32_t last = (e->kin_head - 1) & KINETIC_MASK;
+    int64_t t1 = e->kin_t[last];
+    if (t - t1 > KINETIC_WINDOW_US) return;
+
+    uint32_t first = last;
+    for (uint32_t k = 1; k < e->kin_n; k++) {
+        uint32_t i = (last - k) & KINETIC_MASK;
+        if (t1 - e->kin_t[i] > KINETIC_WINDOW_US) break;
+        first = i;
+    }
+    if (first == last || t1 <= e->kin_t[first]) return;
+
+    float v = (float)(int32_t)(e->kin_a[last] - e->kin_a[first]) / (float)(t1 - e->kin_t[first]);
+    if (fabsf(v) < e->kinetic_min) return;
+    e->kin_v = v;
+    e->kin_rem = 0;
+    e->kin_us = t;
+}
+
+/*
+ * 摩擦は指数減衰: 角速度は kinetic_tau_us で 1/e になり、その間の回転は v*tau*(1-e^(-dt/tau))。
+ * 時刻は kinetic_tick_us の倍数ずつ進めるので、呼び出しが遅れても総回転量は変わらない。
+ */
+void engine_kinetic_tick(engine_t *e, int64_t now_us, engine_result_t *out)
+{
+    out->steps = 0;
+    out->hires = 0;
+    out->actual_steps = 0;
+    out->counted = e->state;
+    out->coalesced = false;
+    out->first_step = false;
+    out->extra_contact = false;
+    out->cancelled = false;
+    if (e->kin_v == 0) return;
+    int64_t n = (now_us - e->kin_us) / e->kinetic_tick_us;
+    if (n <= 0) return;
+
+    float dt = (float)(n * e->kinetic_tick_us);
+    float tau = (float)e->kinetic_tau_us;
+    float k = expf(-dt / tau);
+    e->kin_rem += e->kin_v * tau * (1 - k);
+    e->kin_v *= k;
+    e->kin_us += n * e->kinetic_tick_us;
+    if (fabsf(e->kin_v) < e->kinetic_min) e->kin_v = 0;
+
+    int32_t d = (int32_t)e->kin_rem;
+    e->kin_rem -= (float)d;
+    e->accum_angle += d;
+    if (e->hi_res) {
+        e->hires_accum += d * ENGINE_HIRES_NOTCH;
+        out->hires = take_hires(e, 0, &out->steps);
+        e->accum_angle = 0;
+    } else {
+        out->steps = take_steps(&e->accum_angle, 0, e->step_ang, e->invert);
+    }
+    out->actual_steps = out->steps;
+}
+
+/*
+ * SYN_DROPPED 後の同期フレームで、同期イベントで分かった現在の
+ * BTN_TOUCH と位置から状態を作り直す。
+ *   離れていた       -> 指を離したときと同じ (END)
+ *   途中で触れた     -> 最初の接触と同じ (FIRST)
+ *   触れ続けている   -> 状態はそのままで基準角だけ取り直す (欠けた間の回転は出さない)
+ * 最後の場合は通常の処理を飛ばすので true を返す。
+ */
+static bool resync_state(engine_t *e, const engine_frame_t *f)
+{
+    if (!e->touch_down) {
+        if (e->state != ENGINE_NONE) e->state = ENGINE_END;
+        return false;
+    }
+    if ((f->flags & ENGINE_NEW_CONTACT) || e->state == ENGINE_NONE ||
+        e->state == ENGINE_END || e->state == ENGINE_FIRST) {
+        e->state = ENGINE_FIRST;
+        return false;
+    }
+    anchor(e, f->x, f->y, f->time_us);
+    if (e->state == ENGINE_STARTED_IN_AREA && !geom_in_ring(&e->geom, f->x, f->y))
+        e->staying_in_area = false;
+    return true;
+}
+
+void engine_frame(engine_t *e, const engine_frame_t *f, engine_result_t *out)
+{
+    out->steps = 0;
+    out->hires = 0;
+    out->actual_steps = 0;
+    out->coalesced = false;
+    out->first_step = false;
+    out->extra_contact = false;
+    out->cancelled = false;
+    e->prev_us = e->time_us;
+    e->time_us = f->time_us;
+
+    engine_frame_t local;
+    if (e->mt.seen) {
+        local = *f;
+        mt_bind(e, &local, out);
+        f = &local;
+    }
+
+    // 触れたら慣性は止める (同期し直したときも、続きの角度が分からないので止める)
+    if (f->flags & (ENGINE_TOUCH_DOWN | ENGINE_RESYNC)) {
+        e->kin_v = 0;
+        e->filter_n = 0;
+    }
+    // 追いつき中のスクロールは角度計算と一緒にフィルタも省く (次のフレームで間隔ごと取る)
+    if (e->filter && !((f->flags & ENGINE_COALESCE) && e->state == ENGINE_SCROLLING)) {
+        if (f != &local) {
+            local = *f;
+            f = &local;
+        }
+        filter_xy(e, &local);
+    }
+
+    // BTN_TOUCH はイベントの順に反映していたので、後に来た方 (離した側) を優先する
+    if (f->flags & ENGINE_TOUCH_DOWN) {
+        e->state = ENGINE_FIRST;
+        e->touch_down = true;
+        e->touch_us = f->time_us;
+        e->stepped = false;
+    }
+    if (f->flags & ENGINE_TOUCH_UP) {
+        if (e->state == ENGINE_SCROLLING && e->kinetic_tau_us && !out->cancelled) kinetic_start(e, f->time_us);
+        // 指を離した時点で行き過ぎていた分は戻す (慣性で進み続けるときは戻さない)
+        if (e->state == ENGINE_SCROLLING && e->predict_us && e->kin_v == 0) {
+            if (e->hi_res) out->hires = take_hires(e, 0, &out->steps);
+            else out->steps = retract(e, 0);
+        }
+        e->state = ENGINE_END;
+        e->touch_down = false;
+    }
+
+    if ((f->flags & ENGINE_RESYNC) && resync_state(e, f)) {
+        out->counted = e->state;
+        return;
+    }
+    out->counted = e->state;
+
+    switch (e->state) {
+    case ENGINE_FIRST:
+        // MT では指の数で判定するので、追う指が無い間 (他の指だけが残っている等) は始めない
+        if (e->mt.seen && e->mt.bound < 0) break;
+        if (e->all_wheel || geom_in_ring(&e->geom, f->x, f->y)) {
+            e->state = e->all_wheel ? ENGINE_SCROLLING : ENGINE_STARTED_IN_AREA;
+            e->staying_in_area = true;
+            e->scrolling = false;
+            e->accum_angle = 0;
+            e->actual_angle = 0;
+            e->lead_dir = 0;
+            e->hires_accum = 0;
+            e->notch_accum = 0;
+            e->accel_rem = 0;
+            e->dir = 0;
+            e->reverse_pending = 0;
+            anchor(e, f->x, f->y, f->time_us);
+        } else {
+            e->state = ENGINE_STARTED_NOT_IN_AREA;
+        }
+        break;
+    case ENGINE_STARTED_IN_AREA:
+        // 外周部で閾値以上回転したらスクロールスタート
+        update_xy_before_scroll(e, f->x, f->y, f->time_us);
+        if (e->scrolling) e->state = ENGINE_SCROLLING;
+        break;
+    case ENGINE_SCROLLING:
+        // 追いつき中は次のフレームとの差分でまとめて回転量を取る
+        if (f->flags & ENGINE_COALESCE) {
+            out->coalesced = true;
+            break;
+        }
+        out->steps = update_xy_while_scroll(e, f->x, f->y, f->time_us, &out->actual_steps, &out->hires);
+        if ((out->steps != 0 || out->hires != 0) && !e->stepped) {
+            out->first_step = true;
+            e->stepped = true;
+        }
+        break;
+    case ENGINE_END:
+        e->state = ENGINE_FIRST;
+        break;
+    default:
+        break;
+    }
+}
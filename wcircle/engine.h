@@ -0,0 +1,200 @@
+#ifndef WCIRCLE_ENGINE_H
+#define WCIRCLE_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "geom.h"
+
+/*
+ * ジェスチャエンジン: 外周リングの判定と回転角の積算だけを行う。
+ * 入力はデコード済みのフレーム (SYN_REPORT 時点の位置・BTN_TOUCH の変化・時刻)、
+ * 出力はホイールのステップ数。libevdev や uinput には依存しない。
+ *
+ * engine_frame() はヒープ確保・システムコール・ログを一切行わないので、
+ * コンポジタのプラグイン等に組み込めば uinput を経由せずにスクロール量を得られる。
+ * libwcengine.a (engine.c + geom.c) としてデーモンとは別にビルドできる。
+ */
+
+typedef enum {
+    ENGINE_NONE,                 // 0
+    ENGINE_FIRST,                // 1
+    ENGINE_STARTED_IN_AREA,      // 2
+    ENGINE_STARTED_NOT_IN_AREA,  // 3
+    ENGINE_SCROLLING,            // 4
+    ENGINE_END,                  // 5
+    ENGINE_NSTATES
+} engine_state_t;
+
+#define ENGINE_MT_SLOTS 16   // 追う MT スロットの数 (これ以降のスロットは無視する)
+
+typedef enum {
+    ENGINE_MT_OFF,      // ABS_X/ABS_Y と BTN_TOUCH だけを見る
+    ENGINE_MT_IGNORE,   // ジェスチャを始めた指だけを追い、他の指は無視する
+    ENGINE_MT_CANCEL,   // 2本目の指が触れたらジェスチャを終える
+} engine_mt_mode_t;
+
+/*
+ * MT スロットごとの状態 (struct of arrays)。イベントごとの更新は配列1つへの代入、
+ * フレームごとの判定はビット演算だけなので、ABS_X/ABS_Y だけを見ていたときと手間は変わらない。
+ */
+typedef struct {
+    int32_t id[ENGINE_MT_SLOTS];     // ABS_MT_TRACKING_ID (-1 = 接触なし)
+    int32_t x[ENGINE_MT_SLOTS];      // ABS_MT_POSITION_X
+    int32_t y[ENGINE_MT_SLOTS];      // ABS_MT_POSITION_Y
+    uint32_t active;                 // id >= 0 のスロットのビット
+    int32_t slot;                    // 現在の ABS_MT_SLOT
+    int32_t bound;                   // ジェスチャを始めた指のスロット (-1 = なし)
+    int32_t bound_id;                // その指の tracking id (同じスロットの別の指と区別する)
+    bool waiting;                    // 指が全部離れるまで新しいジェスチャを始めない
+    bool seen;                       // ABS_MT_* を受け取った (無ければ ABS_X/ABS_Y を使う)
+} engine_mt_t;
+
+#define ENGINE_ACCEL_POINTS  8     // 加速カーブの点の最大数
+#define ENGINE_ACCEL_BUCKETS 256   // 加速テーブルの段数
+#define ENGINE_ACCEL_BUCKET_DPS 8  // 1段あたりの角速度 [deg/s] (これ x 段数より速いと最後の段)
+#define ENGINE_ACCEL_ONE     256   // 倍率 1.0 (Q8)
+#define ENGINE_ACCEL_MAX     (16 * ENGINE_ACCEL_ONE)   // 倍率の上限
+
+typedef struct {
+    int    x_min, x_max, y_min, y_max;   // ABS_X / ABS_Y の範囲
+    double outer_ratio_min;   // 外周リングの内側境界（中心からの比）
+    double outer_ratio_max;   // 外周リングの外側境界（比)
+    double start_arc_rad;     // スクロール開始判定: 累積角度 [rad]
+    double step_rad;          // 1ステップあたりの角度 [rad]
+    bool   all_wheel;         // パッド全体をホイールとして扱う
+    bool   invert;            // 時計回りで上
+    int    predict_us;        // 角速度からこの時間だけ先の角度でステップを出す (0 で無効)
+    bool   hi_res;            // 1ステップを ENGINE_HIRES_NOTCH 分割して毎フレーム出す
+    int    kinetic_tau_us;    // 慣性スクロールの減衰の時定数 (0 で無効)
+    double kinetic_min_rad_s; // 慣性を始める/止める角速度 [rad/s]
+    int    kinetic_tick_us;   // 慣性の回転を出す間隔
+    // 加速: 角速度 accel_dps[i] [deg/s] で回転量を accel_gain[i] 倍する (間は線形補間、0点で無効)
+    int    accel_points;
+    double accel_dps[ENGINE_ACCEL_POINTS];
+    double accel_gain[ENGINE_ACCEL_POINTS];
+    // 位置の One-Euro フィルタ: 遮断周波数 = filter_min_cutoff + filter_beta x 速さ (0 で無効)
+    double filter_min_cutoff; // [Hz]
+    double filter_beta;       // 速さはパッドの半幅を1とした [1/s]
+    double reverse_rad;       // スクロール中の逆回転をこの角度までは出さない (0 で無効)
+    engine_mt_mode_t multi_touch;   // MT スロットを追うか・2本目の指をどう扱うか
+} engine_config_t;
+
+#define ENGINE_HIRES_NOTCH 120   // REL_WHEEL_HI_RES の1ノッチ
+#define ENGINE_KINETIC_SAMPLES 16 // 離した時の角速度を求めるために覚えておくフレーム数 (2のべき乗)
+
+// engine_frame_t.flags
+#define ENGINE_TOUCH_DOWN  0x01   // このフレームに BTN_TOUCH 1 がある
+#define ENGINE_TOUCH_UP    0x02   // このフレームに BTN_TOUCH 0 がある
+#define ENGINE_NEW_CONTACT 0x04   // 新しい ABS_MT_TRACKING_ID (ENGINE_RESYNC のときだけ見る)
+#define ENGINE_RESYNC      0x08   // SYN_DROPPED 後の同期フレーム。状態を作り直す
+#define ENGINE_COALESCE    0x10   // 追いつき中: 角度計算を次のフレームに任せてよい
+
+typedef struct {
+    int64_t  time_us;   // SYN_REPORT のタイムスタンプ
+    int32_t  x, y;      // 最新の ABS_X / ABS_Y
+    uint32_t flags;
+} engine_frame_t;
+
+typedef struct {
+    int32_t steps;            // ホイールのステップ数 (符号付き、正 = REL_WHEEL の正方向)
+                              // hi_res では hires の累計から作ったノッチ数
+    int32_t hires;            // hi_res: 1/120 ノッチ単位の回転量 (符号は steps と同じ)
+    int32_t actual_steps;     // 予測しなかった場合のステップ数 (予測の評価用)
+    engine_state_t counted;   // このフレームを受け取った時点の状態 (統計用)
+    bool coalesced;           // 追いつき中のため角度計算を省いた
+    bool first_step;          // この接触で最初にステップを出した
+    bool extra_contact;       // ジェスチャ中に他の指も触れていた
+    bool cancelled;           // 他の指が触れたのでジェスチャを終えた (ENGINE_MT_CANCEL)
+} engine_result_t;
+
+typedef struct {
+    engine_state_t state;
+    geom_t geom;              // リング判定/角度計算の前計算
+    int32_t start_arc_ang;    // start_arc_rad を角度単位 (1周=2^16) にしたもの
+    int32_t step_ang;         // step_rad を角度単位にしたもの
+    geom_ang_t last_angle;    // 直前角 (wrap するので差分は geom_ang_diff で取る)
+    int32_t accum_angle;      // 累積角 [角度単位]
+    bool staying_in_area;     // 開始判定エリアに留まっているか(開始判定用)
+    bool scrolling;           // スクロールモード中か
+    bool touch_down;          // 最新の BTN_TOUCH
+    bool all_wheel;
+    bool invert;
+    int64_t time_us;          // 最後に処理したフレームの時刻
+    int64_t prev_us;          // その1つ前のフレームの時刻 (まとめたフレームも含む)
+    int64_t touch_us;         // BTN_TOUCH 1 のフレームの時刻
+    bool stepped;             // この接触でステップを出したか
+    // 予測 (predict_us > 0)。velocity は加速でも使う
+    int32_t predict_us;
+    int32_t actual_angle;     // 予測しない場合の累積角 (accum_angle と同じ規則で端数を持ち越す)
+    int64_t angle_us;         // last_angle を取ったフレームの時刻
+    float velocity;           // 角速度 [角度単位/us] (指数移動平均)
+    int8_t lead_dir;          // 最後に出したステップの角度の向き (行き過ぎの戻し用。0 = 戻さない)
+    // 高解像度 (hi_res)
+    bool hi_res;
+    int32_t hires_accum;      // まだ出していない角度 x ENGINE_HIRES_NOTCH
+    int32_t notch_accum;      // まだノッチにしていない hires の累計
+    // 慣性スクロール (kinetic_tau_us > 0)
+    int32_t kinetic_tau_us;
+    int32_t kinetic_tick_us;
+    float kinetic_min;        // kinetic_min_rad_s を [角度単位/us] にしたもの
+    uint32_t kin_total;       // 接触中の累積角 (wrap してよい。差分だけ使う)
+    uint32_t kin_a[ENGINE_KINETIC_SAMPLES];  // 直近フレームの kin_total
+    int64_t kin_t[ENGINE_KINETIC_SAMPLES];   // その時刻
+    uint32_t kin_head, kin_n;
+    float kin_v;              // 慣性の角速度 [角度単位/us]。0 なら止まっている
+    float kin_rem;            // まだ角度に足していない1単位未満の回転
+    int64_t kin_us;           // 慣性の回転を最後に進めた時刻 (kinetic_tick_us の倍数ずつ進む)
+    // 加速 (accel_points > 0)
+    bool accel;
+    float accel_scale;        // velocity [角度単位/us] -> accel_lut の段
+    int32_t accel_rem;        // 回転量 x 倍率 の端数 (Q8)
+    int32_t accel_q;          // 直近のフレームの倍率 (Q8)
+    uint16_t accel_lut[ENGINE_ACCEL_BUCKETS];   // 段ごとの倍率 (Q8)
+    // One-Euro フィルタ (filter_min_cutoff > 0)
+    bool filter;
+    uint8_t filter_n;         // 溜まった値の数 (0..2。触れた・同期し直したら捨てる)
+    float filter_min_cutoff, filter_beta;
+    float filter_sx, filter_sy;   // 座標 -> パッドの半幅を1とした単位
+    float fx, fy;             // フィルタ後の位置
+    float fdx, fdy;           // 平滑化した速度 [座標/s]
+    int64_t filter_us;
+    // 逆回転のヒステリシス (reverse_rad > 0)
+    int32_t reverse_ang;
+    int8_t dir;               // スクロール中の回転の向き (0 = まだ無い)
+    int32_t reverse_pending;  // dir と逆向きに溜めてまだ出していない回転
+    // MT スロット (multi_touch != ENGINE_MT_OFF)
+    engine_mt_mode_t mt_mode;
+    engine_mt_t mt;
+} engine_t;
+
+/* 設定から前計算をする (double を使うのはここだけ。予測の角速度は float) */
+void engine_init(engine_t *e, const engine_config_t *cfg);
+/* 1フレーム分の状態遷移。回転がステップを跨いだら out->steps に入る */
+void engine_frame(engine_t *e, const engine_frame_t *f, engine_result_t *out);
+/*
+ * ABS_MT_SLOT / ABS_MT_TRACKING_ID / ABS_MT_POSITION_X/Y をイベント順に渡す (他のコードは無視)。
+ * 受け取っていれば engine_frame() は f->x/y と BTN_TOUCH の代わりにジェスチャを始めた指を使う。
+ */
+void engine_mt_event(engine_t *e, uint16_t code, int32_t value);
+
+/*
+ * 慣性: SCROLLING 中に指を離したとき、直近のフレームの角速度が kinetic_min 以上なら
+ * engine_frame() が慣性を始める。呼び出し側は engine_kinetic_due() の時刻から
+ * kinetic_tick_us ごとに engine_kinetic_tick() を呼び、ステップを出す。
+ * 次に触れる (または同期し直す) か、摩擦で kinetic_min を下回ると止まる。
+ */
+void engine_kinetic_tick(engine_t *e, int64_t now_us, engine_result_t *out);
+
+/* 次に engine_kinetic_tick() を呼ぶ時刻。慣性が止まっていれば 0 */
+static inline int64_t engine_kinetic_due(const engine_t *e)
+{
+    return e->kin_v != 0 ? e->kin_us + e->kinetic_tick_us : 0;
+}
+
+/* SCROLLING 中はパッドの passthrough を止める */
+static inline bool engine_suppress(const engine_t *e)
+{
+    return e->state == ENGINE_SCROLLING;
+}
+
+#endif /* WCIRCLE_ENGINE_H */
@@ -0,0 +1,43 @@
+#include <math.h>
+#include "geom.h"
+
+uint16_t geom_atan_lut[(1 << GEOM_ATAN_LUT_BITS) + 2];
+
+static void init_atan_lut(void)
+{
+    const int n = 1 << GEOM_ATAN_LUT_BITS;
+    for (int i = 0; i <= n; i++)
+        geom_atan_lut[i] = (uint16_t)lround(atan((double)i / n) / (2 * M_PI) * GEOM_ANG_TURN);
+    // t == 1.0 のとき idx+1 を読むので番兵を置く
+    geom_atan_lut[n + 1] = geom_atan_lut[n];
+}
+
+void geom_init(geom_t *g, int x_min, int x_max, int y_min, int y_max,
+               double ratio_min, double ratio_max)
+{
+    if (geom_atan_lut[1 << GEOM_ATAN_LUT_BITS] == 0) init_atan_lut();
+
+    int w = x_max - x_min, h = y_max - y_min;
+    if (w <= 0) w = 1;
+    if (h <= 0) h = 1;
+    g->w = w;
+    g->h = h;
+    g->center2_x = x_min + x_max;
+    g->center2_y = y_min + y_max;
+    g->recip_x = (((int64_t)1 << (GEOM_NORM_BITS + 16)) + w / 2) / w;
+    g->recip_y = (((int64_t)1 << (GEOM_NORM_BITS + 16)) + h / 2) / h;
+
+    const double one2 = (double)((int64_t)1 << (2 * GEOM_NORM_BITS));
+    g->rmin2 = (int64_t)ceil(ratio_min * ratio_min * one2);
+    g->rmax2 = (int64_t)floor(ratio_max * ratio_max * one2);
+}
+
+int32_t geom_rad_to_ang(double rad)
+{
+    return (int32_t)lround(rad / (2 * M_PI) * GEOM_ANG_TURN);
+}
+
+double geom_ang_to_rad(int32_t ang)
+{
+    return (double)ang * (2 * M_PI) / GEOM_ANG_TURN;
+}
@@ -0,0 +1,97 @@
+#ifndef WCIRCLE_GEOM_H
+#define WCIRCLE_GEOM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * 固定小数点のリング判定と角度計算。
+ * ABS_X/ABS_Y の absinfo からデバイス毎に1回だけ geom_t を作り、
+ * SYN_REPORT 毎の処理では除算・sqrt・atan2 (double) を使わない。
+ *
+ * 角度は 1周 = 2^16 の整数 (geom_ang_t)。差分は int16 への丸めで
+ * [-半周, 半周) に正規化されるので while ループでの unwrap は不要。
+ *
+ * 精度 (bench/bench_geom.c で atan2/sqrt の double 実装と比較):
+ *   角度       最大誤差 0.006° (量子化 1 単位 = 0.0055° が支配的)
+ *   リング判定 正規化半径で 2^-14 程度。境界から 1e-4 以上離れた点は double と一致
+ */
+
+#define GEOM_NORM_BITS 14                     // 正規化座標: ±1.0 = ±2^14
+#define GEOM_ANG_BITS  16
+#define GEOM_ANG_TURN  (1 << GEOM_ANG_BITS)   // 1周
+#define GEOM_ANG_HALF  (GEOM_ANG_TURN / 2)
+#define GEOM_ANG_QUARTER (GEOM_ANG_TURN / 4)
+#define GEOM_ATAN_LUT_BITS 8                  // 1/8周を 256 分割して線形補間
+
+typedef uint16_t geom_ang_t;
+
+typedef struct {
+    int32_t center2_x, center2_y;   // (min + max)。2倍座標での中心
+    int32_t w, h;                   // max - min
+    int64_t recip_x, recip_y;       // 2^(NORM_BITS+16) / (max - min)
+    int64_t rmin2, rmax2;           // リング境界の半径^2 (Q28)
+} geom_t;
+
+extern uint16_t geom_atan_lut[(1 << GEOM_ATAN_LUT_BITS) + 2];
+
+void geom_init(geom_t *g, int x_min, int x_max, int y_min, int y_max,
+               double ratio_min, double ratio_max);
+
+/* rad を角度単位に変換 (設定値用。ホットパスでは使わない) */
+int32_t geom_rad_to_ang(double rad);
+double  geom_ang_to_rad(int32_t ang);
+
+// 座標を [-1, 1] の Q14 に正規化
+static inline void geom_norm(const geom_t *g, int x, int y, int32_t *nx, int32_t *ny)
+{
+    *nx = (int32_t)(((int64_t)(2 * x - g->center2_x) * g->recip_x) >> 16);
+    *ny = (int32_t)(((int64_t)(2 * y - g->center2_y) * g->recip_y) >> 16);
+}
+
+static inline bool geom_in_ring(const geom_t *g, int x, int y)
+{
+    int32_t nx, ny;
+    geom_norm(g, x, y, &nx, &ny);
+    int64_t r2 = (int64_t)nx * nx + (int64_t)ny * ny;
+    return r2 >= g->rmin2 && r2 <= g->rmax2;
+}
+
+// atan(n/d) (0 <= n <= d, d > 0) を [0, 1/8周] で返す
+static inline uint32_t geom_atan_octant(uint64_t n, uint64_t d)
+{
+    uint32_t t = (uint32_t)((n << 16) / d);     // Q16, 0..65536
+    uint32_t idx = t >> (16 - GEOM_ATAN_LUT_BITS);
+    uint32_t frac = t & ((1u << (16 - GEOM_ATAN_LUT_BITS)) - 1);
+    int32_t a0 = geom_atan_lut[idx], a1 = geom_atan_lut[idx + 1];
+    return (uint32_t)(a0 + (((a1 - a0) * (int32_t)frac + (1 << (15 - GEOM_ATAN_LUT_BITS)))
+                            >> (16 - GEOM_ATAN_LUT_BITS)));
+}
+
+// |x|, |y| < 2^47
+static inline geom_ang_t geom_atan2(int64_t y, int64_t x)
+{
+    uint64_t ax = (uint64_t)llabs(x), ay = (uint64_t)llabs(y);
+    if (ax == 0 && ay == 0) return 0;
+    uint32_t a = (ay <= ax) ? geom_atan_octant(ay, ax)
+                            : GEOM_ANG_QUARTER - geom_atan_octant(ax, ay);
+    if (x < 0) a = GEOM_ANG_HALF - a;
+    if (y < 0) a = GEOM_ANG_TURN - a;
+    return (geom_ang_t)a;
+}
+
+// atan2(ny, nx) と同じ角度。正規化の丸めを避けて (dy*w, dx*h) で計算する
+static inline geom_ang_t geom_angle(const geom_t *g, int x, int y)
+{
+    int64_t dx = 2 * x - g->center2_x, dy = 2 * y - g->center2_y;
+    return geom_atan2(dy * g->w, dx * g->h);
+}
+
+// a - b を [-半周, 半周) で返す
+static inline int32_t geom_ang_diff(geom_ang_t a, geom_ang_t b)
+{
+    return (int16_t)(uint16_t)(a - b);
+}
+
+#endif /* WCIRCLE_GEOM_H */
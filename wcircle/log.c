@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "log.h"
+
+int log_level = LOG_LVL_INFO;
+
+static const char *const level_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+/* 有界 MPMC キュー (Vyukov) を単一コンシューマで使う */
+typedef struct {
+    atomic_ulong seq;
+    int level;
+    struct timespec ts;
+    char msg[LOG_MSG_MAX];
+} log_slot_t;
+
+static log_slot_t ring[LOG_RING_SIZE];
+static atomic_ulong enqueue_pos;
+static unsigned long dequeue_pos;          // 書き出しスレッドだけが触る
+static atomic_ulong flushed_pos;           // log_flush() 用
+static atomic_ulong dropped;
+static atomic_int  sleeping;               // 書き出しスレッドが futex で寝ているか
+static atomic_bool stopping;
+static pthread_t writer;
+static bool started;
+
+static void futex_wake(atomic_int *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void futex_wait(atomic_int *addr, int val)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void wake_writer(void)
+{
+    if (atomic_exchange(&sleeping, 0)) futex_wake(&sleeping);
+}
+
+static void write_all(const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t w = write(STDERR_FILENO, buf, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        buf += w;
+        len -= (size_t)w;
+    }
+}
+
+// "[時刻] [レベル] メッセージ\n" を out に書き、長さを返す (len - 1 まで)
+static size_t format_line(char *out, size_t len, int level, const struct timespec *ts, const char *msg)
+{
+    struct tm tm_info;
+    char time_buf[20];
+    localtime_r(&ts->tv_sec, &tm_info);
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_info);
+    int w = snprintf(out, len, "[%s] [%s] %s\n", time_buf, level_names[level], msg);
+    if (w < 0) return 0;
+    return (size_t)w < len ? (size_t)w : len - 1;
+}
+
+// 溜まっている分を1回の write() にまとめて書き出す。書き出した件数を返す
+static int drain(void)
+{
+    char out[8192];
+    size_t off = 0;
+    int n = 0;
+
+    for (;;) {
+        log_slot_t *s = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&s->seq, memory_order_acquire) != dequeue_pos + 1) break;
+
+        if (off + LOG_MSG_MAX + 64 > sizeof(out)) {
+            write_all(out, off);
+            off = 0;
+        }
+        off += format_line(out + off, sizeof(out) - off, s->level, &s->ts, s->msg);
+
+        atomic_store_explicit(&s->seq, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+        dequeue_pos++;
+        n++;
+    }
+    if (off > 0) write_all(out, off);
+    atomic_store_explicit(&flushed_pos, dequeue_pos, memory_order_release);
+    return n;
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        if (drain() > 0) continue;
+        if (atomic_load(&stopping)) break;
+        atomic_store(&sleeping, 1);
+        // 寝る直前に積まれた分を取りこぼさないよう再確認
+        if (drain() > 0) {
+            atomic_store(&sleeping, 0);
+            continue;
+        }
+        if (atomic_load(&stopping)) break;
+        futex_wait(&sleeping, 1);
+    }
+    drain();
+    return NULL;
+}
+
+void log_init(void)
+{
+    for (unsigned long i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&ring[i].seq, i);
+    started = pthread_create(&writer, NULL, writer_main, NULL) == 0;
+}
+
+void log_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!started) {
+        // スレッドが無い (起動前 / 終了後) ときは同じ書式で同期で書く
+        char msg[LOG_MSG_MAX], line[LOG_MSG_MAX + 64];
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        va_start(ap, fmt);
+        vsnprintf(msg, sizeof(msg), fmt, ap);
+        va_end(ap);
+        write_all(line, format_line(line, sizeof(line), level, &ts, msg));
+        return;
+    }
+
+    unsigned long pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_slot_t *s;
+    for (;;) {
+        s = &ring[pos & (LOG_RING_SIZE - 1)];
+        unsigned long seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            wake_writer();
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    s->level = level;
+    clock_gettime(CLOCK_REALTIME_COARSE, &s->ts);
+    va_start(ap, fmt);
+    vsnprintf(s->msg, sizeof(s->msg), fmt, ap);
+    va_end(ap);
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    wake_writer();
+}
+
+void log_flush(void)
+{
+    if (!started) return;
+    unsigned long target = atomic_load(&enqueue_pos);
+    const struct timespec ms = { 0, 1000000 };
+    while (atomic_load_explicit(&flushed_pos, memory_order_acquire) < target) {
+        wake_writer();
+        nanosleep(&ms, NULL);
+    }
+}
+
+void log_shutdown(void)
+{
+    if (!started) return;
+    atomic_store(&stopping, true);
+    atomic_store(&sleeping, 0);
+    futex_wake(&sleeping);
+    pthread_join(writer, NULL);
+    started = false;
+}
+
+unsigned long log_dropped(void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+int log_level_from_string(const char *s)
+{
+    for (int i = 0; i <= LOG_LVL_DEBUG; i++)
+        if (strcasecmp(s, level_names[i]) == 0) return i;
+    if (strcasecmp(s, "warning") == 0) return LOG_LVL_WARN;
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (*s && !*end && v >= LOG_LVL_ERROR && v <= LOG_LVL_DEBUG) return (int)v;
+    return -1;
+}
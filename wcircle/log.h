@@ -0,0 +1,43 @@
+#ifndef WCIRCLE_LOG_H
+#define WCIRCLE_LOG_H
+
+/*
+ * 非同期ロガー。呼び出し側はロックフリーのリングに整形して積むだけで、
+ * 時刻の文字列化と stderr への書き込みは専用スレッドが行う。
+ * リングが満杯のときは捨てて log_dropped() に数える (イベントループを止めない)。
+ *
+ * -DWCIRCLE_NO_DEBUG_LOG でイベント毎の LOG_DEBUG をコンパイル時に除去する。
+ */
+
+enum {
+    LOG_LVL_ERROR = 0,
+    LOG_LVL_WARN  = 1,
+    LOG_LVL_INFO  = 2,
+    LOG_LVL_DEBUG = 3,
+};
+
+#define LOG_RING_SIZE 256   // 2のべき乗
+#define LOG_MSG_MAX   200
+
+extern int log_level;
+
+void log_init(void);
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+/* 積まれている分を書き出し終わるまで待つ */
+void log_flush(void);
+void log_shutdown(void);
+unsigned long log_dropped(void);
+/* "error" / "warn" / "info" / "debug" または数値。不明なら -1 */
+int log_level_from_string(const char *s);
+
+#define LOG_AT(lvl, ...) do { if ((lvl) <= log_level) log_write((lvl), __VA_ARGS__); } while (0)
+#define LOG_ERROR(...) LOG_AT(LOG_LVL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LVL_WARN,  __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LVL_INFO,  __VA_ARGS__)
+#ifdef WCIRCLE_NO_DEBUG_LOG
+#define LOG_DEBUG(...) do { } while (0)
+#else
+#define LOG_DEBUG(...) LOG_AT(LOG_LVL_DEBUG, __VA_ARGS__)
+#endif
+
+#endif /* WCIRCLE_LOG_H */
@@ -0,0 +1,151 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "pipeline.h"
+
+static void futex_wake(atomic_int *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void futex_wait(atomic_int *addr, int val)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void wake_consumer(pipeline_t *pl)
+{
+    if (atomic_exchange(&pl->sleeping, 0)) futex_wake(&pl->sleeping);
+}
+
+// tail を進めた後に呼ぶ。空きを待っているプロデューサがいれば起こす
+static void wake_producer(pipeline_t *pl)
+{
+    // tail の公開と waiting の読み出しを入れ替えない (wait_tail の fence と対)
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pl->waiting, memory_order_relaxed) && atomic_exchange(&pl->waiting, 0))
+        futex_wake(&pl->waiting);
+}
+
+// tail が target に届くまで寝て待つ (プロデューサ側)
+static void wait_tail(pipeline_t *pl, unsigned long target)
+{
+    while (atomic_load_explicit(&pl->tail, memory_order_acquire) < target) {
+        atomic_store_explicit(&pl->waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        // 寝る直前に空いた分を取りこぼさないよう再確認
+        if (atomic_load_explicit(&pl->tail, memory_order_acquire) >= target) {
+            atomic_store_explicit(&pl->waiting, 0, memory_order_relaxed);
+            break;
+        }
+        wake_consumer(pl);
+        futex_wait(&pl->waiting, 1);
+    }
+}
+
+// 溜まっている分を処理する。処理したフレーム数を返す
+static unsigned long drain(pipeline_t *pl)
+{
+    unsigned long tail = atomic_load_explicit(&pl->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&pl->head, memory_order_acquire);
+    for (unsigned long pos = tail; pos != head; pos++) {
+        pl->fn(pl->ctx, &pl->slots[pos & pl->mask]);
+        atomic_store_explicit(&pl->tail, pos + 1, memory_order_release);
+        wake_producer(pl);
+    }
+    return head - tail;
+}
+
+static void *consumer_main(void *arg)
+{
+    pipeline_t *pl = arg;
+    for (;;) {
+        if (drain(pl) > 0) continue;
+        if (atomic_load(&pl->stopping)) break;
+        atomic_store(&pl->sleeping, 1);
+        // 寝る直前に積まれた分を取りこぼさないよう再確認
+        if (atomic_load(&pl->head) != atomic_load_explicit(&pl->tail, memory_order_relaxed)) {
+            atomic_store(&pl->sleeping, 0);
+            continue;
+        }
+        if (atomic_load(&pl->stopping)) break;
+        futex_wait(&pl->sleeping, 1);
+    }
+    drain(pl);
+    return NULL;
+}
+
+int pipeline_start(pipeline_t *pl, size_t capacity, bool lossless, pipeline_fn fn, void *ctx)
+{
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    memset(pl, 0, sizeof(*pl));
+    pl->slots = calloc(cap, sizeof(*pl->slots));
+    if (!pl->slots) return -ENOMEM;
+    pl->mask = cap - 1;
+    pl->lossless = lossless;
+    pl->fn = fn;
+    pl->ctx = ctx;
+    int rc = pthread_create(&pl->thread, NULL, consumer_main, pl);
+    if (rc != 0) {
+        free(pl->slots);
+        pl->slots = NULL;
+        return -rc;
+    }
+    pl->started = true;
+    return 0;
+}
+
+bool pipeline_push(pipeline_t *pl, const pipe_frame_t *f, bool must)
+{
+    unsigned long head = atomic_load_explicit(&pl->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&pl->tail, memory_order_acquire) > pl->mask) {
+        if (!must && !pl->lossless) {
+            pl->overflow++;
+            wake_consumer(pl);
+            return false;
+        }
+        pl->stalls++;
+        wait_tail(pl, head - pl->mask);
+    }
+
+    pipe_frame_t *s = &pl->slots[head & pl->mask];
+    s->pad = f->pad;
+    s->n = f->n;
+    s->coalesce = f->coalesce;
+    s->resync = f->resync;
+    s->kinetic = f->kinetic;
+    memcpy(s->ev, f->ev, f->n * sizeof(f->ev[0]));
+    // sleeping との順序を保つため seq_cst で公開する
+    atomic_store(&pl->head, head + 1);
+    wake_consumer(pl);
+
+    pl->pushed++;
+    unsigned long depth = head + 1 - atomic_load_explicit(&pl->tail, memory_order_relaxed);
+    if (depth > pl->max_depth) pl->max_depth = depth;
+    return true;
+}
+
+void pipeline_quiesce(pipeline_t *pl)
+{
+    if (!pl->started) return;
+    wait_tail(pl, atomic_load_explicit(&pl->head, memory_order_relaxed));
+}
+
+void pipeline_stop(pipeline_t *pl)
+{
+    if (!pl->started) return;
+    atomic_store(&pl->stopping, true);
+    atomic_store(&pl->sleeping, 0);
+    futex_wake(&pl->sleeping);
+    pthread_join(pl->thread, NULL);
+    free(pl->slots);
+    pl->slots = NULL;
+    pl->started = false;
+}
@@ -0,0 +1,71 @@
+#ifndef WCIRCLE_PIPELINE_H
+#define WCIRCLE_PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+/*
+ * 読み取り側 (passthrough) とジェスチャ処理側を分けるためのフレームキュー。
+ * 単一プロデューサ/単一コンシューマのロックフリーリングで、
+ * コンシューマは専用スレッドで動き、空のときは futex で寝る。
+ * プロデューサも満杯で待つときは futex で寝て、コンシューマが1つ空けるたびに起こされる。
+ *
+ * tail はフレームを処理し終えてから進めるので、head == tail なら
+ * 積んだフレームはすべて処理済み (pipeline_quiesce はこれを待つ)。
+ */
+
+#define PIPE_FRAME_MAX 64   // 1フレームに入れるイベント数の上限 (超えたら分割する)
+
+typedef struct {
+    uint32_t pad;           // 発生元 (呼び出し側の識別子)
+    uint32_t n;
+    bool coalesce;          // 読み取り側の追いつきモードで角度計算を次のフレームに任せる
+    bool resync;            // SYN_DROPPED 後の同期イベント (状態を作り直す)
+    bool kinetic;           // 慣性スクロールのタイマーが満了した (ev は空)
+    struct input_event ev[PIPE_FRAME_MAX];
+} pipe_frame_t;
+
+typedef void (*pipeline_fn)(void *ctx, const pipe_frame_t *f);
+
+typedef struct {
+    _Alignas(64) atomic_ulong head;   // プロデューサだけが進める
+    _Alignas(64) atomic_ulong tail;   // コンシューマだけが進める
+    atomic_int sleeping;              // コンシューマが futex で寝ているか
+    atomic_int waiting;               // プロデューサが空き (tail の前進) を futex で待っているか
+    atomic_bool stopping;
+    _Alignas(64) pipe_frame_t *slots;
+    size_t mask;
+    bool lossless;                    // 満杯でも捨てずに待つ (replay 用)
+    bool started;
+    pthread_t thread;
+    pipeline_fn fn;
+    void *ctx;
+    // 以下はプロデューサだけが書く
+    unsigned long pushed;             // 積んだフレーム数
+    unsigned long overflow;           // 満杯で捨てたフレーム数
+    unsigned long stalls;             // 満杯で空くのを待った回数
+    unsigned long max_depth;          // 積んだ直後の最大段数
+} pipeline_t;
+
+/* capacity は2のべき乗に切り上げる。fn はコンシューマスレッドで呼ばれる。失敗で -errno */
+int  pipeline_start(pipeline_t *pl, size_t capacity, bool lossless, pipeline_fn fn, void *ctx);
+/*
+ * フレームを1つ積む (f->n 個だけコピー)。満杯のとき must か lossless なら空くまで寝て待ち、
+ * そうでなければ捨てて overflow に数える。積めたら true
+ */
+bool pipeline_push(pipeline_t *pl, const pipe_frame_t *f, bool must);
+/* 積んだフレームをすべて処理し終わるまで待つ */
+void pipeline_quiesce(pipeline_t *pl);
+void pipeline_stop(pipeline_t *pl);
+
+static inline unsigned long pipeline_depth(const pipeline_t *pl)
+{
+    return atomic_load_explicit(&pl->head, memory_order_relaxed) -
+           atomic_load_explicit(&pl->tail, memory_order_relaxed);
+}
+
+#endif /* WCIRCLE_PIPELINE_H */
@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <libevdev-1.0/libevdev/libevdev.h>
+#include "replay.h"
+
+int recorder_open(recorder_t *rec, const char *path,
+                  const struct input_absinfo *xi, const struct input_absinfo *yi)
+{
+    wcrec_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, WCREC_MAGIC, sizeof(hdr.magic));
+    hdr.version = WCREC_VERSION;
+    hdr.abs_x = *xi;
+    hdr.abs_y = *yi;
+
+    rec->fp = fopen(path, "wb");
+    if (!rec->fp) return -errno;
+    if (fwrite(&hdr, sizeof(hdr), 1, rec->fp) != 1) {
+        int err = errno ? errno : EIO;
+        fclose(rec->fp);
+        rec->fp = NULL;
+        return -err;
+    }
+    return 0;
+}
+
+int recorder_write(recorder_t *rec, const struct input_event *ev)
+{
+    wcrec_event_t r = {
+        .time_us = (int64_t)ev->input_event_sec * 1000000 + ev->input_event_usec,
+        .type    = ev->type,
+        .code    = ev->code,
+        .value   = ev->value,
+    };
+    if (fwrite(&r, sizeof(r), 1, rec->fp) != 1) return errno ? -errno : -EIO;
+    return 0;
+}
+
+void recorder_close(recorder_t *rec)
+{
+    if (rec->fp) fclose(rec->fp);
+    rec->fp = NULL;
+}
+
+int replay_open(replay_t *rp, const char *path, bool realtime)
+{
+    memset(rp, 0, sizeof(*rp));
+    rp->realtime = realtime;
+
+    rp->fp = fopen(path, "rb");
+    if (!rp->fp) return -errno;
+    if (fread(&rp->hdr, sizeof(rp->hdr), 1, rp->fp) != 1 ||
+        memcmp(rp->hdr.magic, WCREC_MAGIC, sizeof(rp->hdr.magic)) != 0 ||
+        rp->hdr.version != WCREC_VERSION) {
+        fclose(rp->fp);
+        rp->fp = NULL;
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int read_record(replay_t *rp, struct input_event *ev, bool may_block)
+{
+    wcrec_event_t r;
+    if (rp->have_held) {
+        r = rp->held;
+        rp->have_held = false;
+        may_block = false;
+    } else if (fread(&r, sizeof(r), 1, rp->fp) != 1) {
+        return -ENODATA;
+    }
+
+    memset(ev, 0, sizeof(*ev));
+    ev->input_event_sec  = r.time_us / 1000000;
+    ev->input_event_usec = r.time_us % 1000000;
+    ev->type  = r.type;
+    ev->code  = r.code;
+    ev->value = r.value;
+
+    if (rp->realtime) {
+        // 最初のイベントからの経過時間に合わせて待つ
+        if (!rp->started) {
+            rp->first_us = r.time_us;
+            clock_gettime(CLOCK_MONOTONIC, &rp->start_ts);
+            rp->started = true;
+        }
+        int64_t off_ns = (r.time_us - rp->first_us) * 1000;
+        struct timespec due = rp->start_ts;
+        due.tv_sec  += off_ns / 1000000000;
+        due.tv_nsec += off_ns % 1000000000;
+        if (due.tv_nsec >= 1000000000) { due.tv_sec++; due.tv_nsec -= 1000000000; }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (may_block && (now.tv_sec < due.tv_sec ||
+                          (now.tv_sec == due.tv_sec && now.tv_nsec < due.tv_nsec))) {
+            rp->held = r;
+            rp->have_held = true;
+            return -EAGAIN;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+            ;
+        // 再生時刻 (CLOCK_MONOTONIC) に付け替えて実機と同じように遅延を測れるようにする
+        ev->input_event_sec  = due.tv_sec;
+        ev->input_event_usec = due.tv_nsec / 1000;
+    }
+    rp->events++;
+    return 0;
+}
+
+static bool is_syn_report(const struct input_event *ev)
+{
+    return ev->type == EV_SYN && ev->code == SYN_REPORT;
+}
+
+int replay_next_event(replay_t *rp, unsigned int flags, struct input_event *ev)
+{
+    int rc;
+
+    if (flags & LIBEVDEV_READ_FLAG_SYNC) {
+        // 同期イベント列は SYN_REPORT まで。終わったら -EAGAIN
+        if (!rp->in_sync) return -EAGAIN;
+        if ((rc = read_record(rp, ev, false)) < 0) return rc;
+        if (is_syn_report(ev)) rp->in_sync = false;
+        return LIBEVDEV_READ_STATUS_SYNC;
+    }
+
+    // 同期中に通常読み出しされたら libevdev 同様に残りの同期イベントを捨てる
+    while (rp->in_sync) {
+        if ((rc = read_record(rp, ev, false)) < 0) return rc;
+        if (is_syn_report(ev)) rp->in_sync = false;
+    }
+
+    if ((rc = read_record(rp, ev, true)) < 0) return rc;
+    if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+        rp->in_sync = true;
+        return LIBEVDEV_READ_STATUS_SYNC;
+    }
+    return LIBEVDEV_READ_STATUS_SUCCESS;
+}
+
+void replay_close(replay_t *rp)
+{
+    if (rp->fp) fclose(rp->fp);
+    rp->fp = NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef WCIRCLE_REPLAY_H
+#define WCIRCLE_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <linux/input.h>
+
+/*
+ * 録画ファイル形式 (ネイティブエンディアン)
+ *   header : wcrec_header_t
+ *   body   : wcrec_event_t が EOF まで並ぶ
+ * SYN_DROPPED 以降 SYN_REPORT までのレコードは libevdev の同期イベント列。
+ */
+#define WCREC_MAGIC   "WCRC"
+#define WCREC_VERSION 1
+
+typedef struct {
+    char     magic[4];            // "WCRC"
+    uint32_t version;
+    struct input_absinfo abs_x;   // 録画元デバイスの ABS_X
+    struct input_absinfo abs_y;   // 録画元デバイスの ABS_Y
+} wcrec_header_t;
+
+typedef struct {
+    int64_t  time_us;   // カーネルタイムスタンプ [us]
+    uint16_t type;
+    uint16_t code;
+    int32_t  value;
+} wcrec_event_t;
+
+typedef struct {
+    FILE *fp;
+} recorder_t;
+
+typedef struct {
+    FILE *fp;
+    wcrec_header_t hdr;
+    bool realtime;             // 元のタイミングで再生するか (時刻は CLOCK_MONOTONIC に付け替え)
+    bool in_sync;              // SYN_DROPPED 後の同期イベント列を返している最中か
+    bool started;
+    int64_t first_us;          // 最初のイベントの時刻
+    struct timespec start_ts;  // 再生開始時刻 (CLOCK_MONOTONIC)
+    wcrec_event_t held;        // まだ時刻になっていないので -EAGAIN を返して保留した記録
+    bool have_held;
+    unsigned long events;      // 返したイベント数
+} replay_t;
+
+/* 成功で 0、失敗で -errno を返す */
+int  recorder_open(recorder_t *rec, const char *path,
+                   const struct input_absinfo *xi, const struct input_absinfo *yi);
+int  recorder_write(recorder_t *rec, const struct input_event *ev);
+void recorder_close(recorder_t *rec);
+
+int  replay_open(replay_t *rp, const char *path, bool realtime);
+/*
+ * libevdev_next_event() と同じ戻り値。EOF では -ENODATA。
+ * realtime ではまだ届いていないイベントに一度 -EAGAIN を返し (実機で読み切ったのと同じ)、
+ * 次の呼び出しでその時刻まで待つ。
+ */
+int  replay_next_event(replay_t *rp, unsigned int flags, struct input_event *ev);
+void replay_close(replay_t *rp);
+
+#endif /* WCIRCLE_REPLAY_H */
@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "log.h"
+#include "rt.h"
+
+#define RT_PREFAULT_MAX_KB 1024   // 既定のスタック上限 (8MB) より十分小さく
+
+// スタックを kb だけ触ってページを割り当てておく (mlockall 後に呼ぶと固定される)
+static __attribute__((noinline)) void prefault_stack(int kb)
+{
+    size_t len = (size_t)kb * 1024;
+    volatile char buf[len];
+    for (size_t i = 0; i < len; i += 4096) buf[i] = 0;
+    (void)buf[len - 1];
+}
+
+void rt_apply(const rt_config_t *cfg, rt_status_t *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->requested = true;
+    st->policy = sched_getscheduler(0);
+    st->cpu = -1;
+
+    if (cfg->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg->cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            LOG_WARN("rt: can't pin to CPU %d: %s", cfg->cpu, strerror(errno));
+        else
+            st->cpu = cfg->cpu;
+    }
+
+    int min = sched_get_priority_min(SCHED_FIFO), max = sched_get_priority_max(SCHED_FIFO);
+    struct sched_param sp = { .sched_priority = cfg->priority };
+    if (sp.sched_priority < min) sp.sched_priority = min;
+    if (sp.sched_priority > max) sp.sched_priority = max;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp) < 0) {
+        LOG_WARN("rt: can't switch to SCHED_FIFO %d: %s; staying SCHED_OTHER", sp.sched_priority, strerror(errno));
+    } else {
+        st->policy = SCHED_FIFO;
+        st->priority = sp.sched_priority;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        LOG_WARN("rt: mlockall failed: %s; pages may still fault", strerror(errno));
+    } else {
+        st->mlocked = true;
+    }
+
+    int kb = cfg->prefault_kb;
+    if (kb > RT_PREFAULT_MAX_KB) kb = RT_PREFAULT_MAX_KB;
+    if (kb > 0) {
+        prefault_stack(kb);
+        st->prefault_kb = kb;
+    }
+    LOG_INFO("rt: policy=%s priority=%d cpu=%d mlocked=%d prefault=%dKB",
+             st->policy == SCHED_FIFO ? "fifo" : "other", st->priority, st->cpu,
+             st->mlocked, st->prefault_kb);
+}
+
+void rt_apply_thread(pthread_t thread, int priority, const rt_status_t *st)
+{
+    if (st->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(st->cpu, &set);
+        pthread_setaffinity_np(thread, sizeof(set), &set);
+    }
+    if (st->policy != SCHED_FIFO) return;
+    struct sched_param sp = { .sched_priority = priority };
+    if (sp.sched_priority < sched_get_priority_min(SCHED_FIFO))
+        sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    int rc = pthread_setschedparam(thread, SCHED_FIFO, &sp);
+    if (rc != 0) LOG_WARN("rt: can't set thread priority %d: %s", sp.sched_priority, strerror(rc));
+}
+
+size_t rt_format(const rt_status_t *st, char *buf, size_t len)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    int n = snprintf(buf, len,
+                     "rt_requested=%d\n"
+                     "rt_policy=%s\n"
+                     "rt_priority=%d\n"
+                     "rt_cpu=%d\n"
+                     "rt_mlocked=%d\n"
+                     "rt_prefault_kb=%d\n"
+                     "minor_faults=%ld\n"
+                     "major_faults=%ld\n"
+                     "involuntary_ctx_switches=%ld\n",
+                     st->requested, st->policy == SCHED_FIFO ? "fifo" : "other",
+                     st->priority, st->cpu, st->mlocked, st->prefault_kb,
+                     ru.ru_minflt, ru.ru_majflt, ru.ru_nivcsw);
+    if (n < 0) return 0;
+    return (size_t)n < len ? (size_t)n : len - 1;
+}
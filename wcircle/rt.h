@@ -0,0 +1,35 @@
+#ifndef WCIRCLE_RT_H
+#define WCIRCLE_RT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * 低遅延モード: SCHED_FIFO・CPU 固定・mlockall・スタックの事前フォルト。
+ * 権限が無い等で失敗した項目は警告を出して飛ばし、結果を rt_status_t に残す。
+ */
+
+typedef struct {
+    int priority;        // SCHED_FIFO の優先度 (1..99)
+    int cpu;             // 固定する CPU (-1 で固定しない)
+    int prefault_kb;     // 事前にフォルトさせるスタック量
+} rt_config_t;
+
+typedef struct {
+    bool requested;
+    int  policy;         // 実際のスケジューリングポリシー
+    int  priority;
+    int  cpu;            // 固定できた CPU (-1 = なし)
+    bool mlocked;
+    int  prefault_kb;
+} rt_status_t;
+
+/* 呼び出したスレッドに適用する。init が終わってから (mlockall の前に確保を済ませて) 呼ぶ */
+void rt_apply(const rt_config_t *cfg, rt_status_t *st);
+/* 別スレッド (ジェスチャスレッド等) を同じ CPU・priority で動かす */
+void rt_apply_thread(pthread_t thread, int priority, const rt_status_t *st);
+/* rt_* とページフォルト・非自発的コンテキストスイッチ数を key=value で書く */
+size_t rt_format(const rt_status_t *st, char *buf, size_t len);
+
+#endif /* WCIRCLE_RT_H */
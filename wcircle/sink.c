@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libevdev-1.0/libevdev/libevdev-uinput.h>
+#include "replay.h"
+#include "sink.h"
+
+/* ---- uinput ---- */
+
+typedef struct {
+    sink_t base;
+    int fd;
+} uinput_sink_t;
+
+static int uinput_write(sink_t *s, const struct input_event *evs, size_t n)
+{
+    uinput_sink_t *u = (uinput_sink_t *)s;
+    size_t len = n * sizeof(*evs);
+    ssize_t rc;
+    do {
+        rc = write(u->fd, evs, len);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0) return -errno;
+    if ((size_t)rc != len) return -EIO;
+    return 0;
+}
+
+static void uinput_close(sink_t *s)
+{
+    free(s);
+}
+
+static const sink_ops_t uinput_ops = { "uinput", uinput_write, uinput_close };
+
+sink_t *sink_uinput_new(struct libevdev_uinput *uidev)
+{
+    uinput_sink_t *u = calloc(1, sizeof(*u));
+    if (!u) return NULL;
+    u->base.ops = &uinput_ops;
+    u->fd = libevdev_uinput_get_fd(uidev);
+    return &u->base;
+}
+
+/* ---- file ---- */
+
+typedef struct {
+    sink_t base;
+    recorder_t rec;
+} file_sink_t;
+
+static int file_write(sink_t *s, const struct input_event *evs, size_t n)
+{
+    file_sink_t *f = (file_sink_t *)s;
+    for (size_t i = 0; i < n; i++) {
+        int rc = recorder_write(&f->rec, &evs[i]);
+        if (rc < 0) return rc;
+    }
+    return 0;
+}
+
+static void file_close(sink_t *s)
+{
+    file_sink_t *f = (file_sink_t *)s;
+    recorder_close(&f->rec);
+    free(f);
+}
+
+static const sink_ops_t file_ops = { "file", file_write, file_close };
+
+sink_t *sink_file_new(const char *path, const struct input_absinfo *xi, const struct input_absinfo *yi)
+{
+    static const struct input_absinfo none;
+    file_sink_t *f = calloc(1, sizeof(*f));
+    if (!f) return NULL;
+    f->base.ops = &file_ops;
+    int rc = recorder_open(&f->rec, path, xi ? xi : &none, yi ? yi : &none);
+    if (rc < 0) {
+        free(f);
+        errno = -rc;
+        return NULL;
+    }
+    return &f->base;
+}
+
+/* ---- ring ---- */
+
+typedef struct {
+    sink_t base;
+    size_t mask;
+    unsigned long head;     // 次に書く位置 (単調増加)
+    struct input_event buf[];
+} ring_sink_t;
+
+static int ring_write(sink_t *s, const struct input_event *evs, size_t n)
+{
+    ring_sink_t *r = (ring_sink_t *)s;
+    for (size_t i = 0; i < n; i++)
+        r->buf[r->head++ & r->mask] = evs[i];
+    return 0;
+}
+
+static void ring_close(sink_t *s)
+{
+    free(s);
+}
+
+static const sink_ops_t ring_ops = { "ring", ring_write, ring_close };
+
+sink_t *sink_ring_new(size_t capacity)
+{
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+    ring_sink_t *r = calloc(1, sizeof(*r) + cap * sizeof(r->buf[0]));
+    if (!r) return NULL;
+    r->base.ops = &ring_ops;
+    r->mask = cap - 1;
+    return &r->base;
+}
+
+/* ---- null ---- */
+
+static int null_write(sink_t *s, const struct input_event *evs, size_t n)
+{
+    (void)s; (void)evs; (void)n;
+    return 0;
+}
+
+static void null_close(sink_t *s)
+{
+    free(s);
+}
+
+static const sink_ops_t null_ops = { "null", null_write, null_close };
+
+sink_t *sink_null_new(void)
+{
+    sink_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->ops = &null_ops;
+    return s;
+}
+
+sink_t *sink_from_spec(const char *spec, struct libevdev_uinput *uidev,
+                       const struct input_absinfo *xi, const struct input_absinfo *yi)
+{
+    if (strcmp(spec, "uinput") == 0) {
+        if (uidev) return sink_uinput_new(uidev);
+        errno = ENODEV;
+        return NULL;
+    }
+    if (strcmp(spec, "null") == 0)
+        return sink_null_new();
+    if (strcmp(spec, "ring") == 0)
+        return sink_ring_new(4096);
+    if (strncmp(spec, "ring:", 5) == 0)
+        return sink_ring_new(strtoul(spec + 5, NULL, 10));
+    if (strncmp(spec, "file:", 5) == 0)
+        return sink_file_new(spec + 5, xi, yi);
+    errno = EINVAL;
+    return NULL;
+}
+
+void sink_close(sink_t *s)
+{
+    if (s) s->ops->close(s);
+}
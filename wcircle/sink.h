@@ -0,0 +1,58 @@
+#ifndef WCIRCLE_SINK_H
+#define WCIRCLE_SINK_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <linux/input.h>
+
+struct libevdev_uinput;
+
+/*
+ * 出力先 (passthrough 用タッチパッド / スクロール用仮想マウス) の抽象化。
+ * write は input_event 配列をまとめて受け取り、成功で 0、失敗で -errno を返す。
+ */
+typedef struct sink sink_t;
+
+typedef struct {
+    const char *name;
+    int  (*write)(sink_t *s, const struct input_event *evs, size_t n);
+    void (*close)(sink_t *s);
+} sink_ops_t;
+
+struct sink {
+    const sink_ops_t *ops;
+    // mouse sink はジェスチャスレッドが書き、統計は読み取りスレッドが読むので atomic
+    _Atomic unsigned long events;   // 受け取ったイベント数
+    _Atomic unsigned long writes;   // write 呼び出し回数
+};
+
+/* uinput: 1回の write() で uinput fd に送る。uidev の所有権は呼び出し側 */
+sink_t *sink_uinput_new(struct libevdev_uinput *uidev);
+/* file: 録画ファイルと同じ形式で書き出す (xi/yi は NULL 可)。失敗で NULL (errno を設定) */
+sink_t *sink_file_new(const char *path, const struct input_absinfo *xi, const struct input_absinfo *yi);
+/* ring: 直近 capacity 個 (2のべき乗に切り上げ) をメモリに保持する */
+sink_t *sink_ring_new(size_t capacity);
+/* null: 数えるだけで捨てる */
+sink_t *sink_null_new(void);
+
+/*
+ * "uinput" / "null" / "ring[:N]" / "file:PATH" から生成。uinput には uidev が必要。
+ * 失敗で NULL を返し errno を設定する (書式が違えば EINVAL、uidev が無ければ ENODEV、
+ * file は開けなかった理由)
+ */
+sink_t *sink_from_spec(const char *spec, struct libevdev_uinput *uidev,
+                       const struct input_absinfo *xi, const struct input_absinfo *yi);
+
+static inline int sink_write(sink_t *s, const struct input_event *evs, size_t n)
+{
+    // 書くのは1スレッドだけなので load + store で足りる
+    atomic_store_explicit(&s->events, atomic_load_explicit(&s->events, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+    atomic_store_explicit(&s->writes, atomic_load_explicit(&s->writes, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return s->ops->write(s, evs, n);
+}
+
+void sink_close(sink_t *s);
+
+#endif /* WCIRCLE_SINK_H */
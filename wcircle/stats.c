@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "stats.h"
+
+static int hist_index(uint64_t v)
+{
+    if (v < HIST_SUB) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    if (e >= HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    int sub = (int)(v >> (e - HIST_SUB_BITS)) - HIST_SUB;
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+// バケットの上端値
+static uint64_t hist_value(int idx)
+{
+    if (idx < HIST_SUB) return (uint64_t)idx;
+    int e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(idx % HIST_SUB);
+    uint64_t width = 1ULL << (e - HIST_SUB_BITS);
+    return (HIST_SUB + sub) * width + width - 1;
+}
+
+void hist_record(hist_t *h, uint64_t v)
+{
+    // 書くのは1スレッドだけ (stats_add と同じ)
+    int i = hist_index(v);
+    atomic_store_explicit(&h->counts[i], atomic_load_explicit(&h->counts[i], memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&h->total, atomic_load_explicit(&h->total, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    if (v > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, v, memory_order_relaxed);
+}
+
+uint64_t hist_percentile(const hist_t *h, double p)
+{
+    uint64_t total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    if (total == 0) return 0;
+    uint64_t target = (uint64_t)(p * (double)total + 0.5);
+    if (target == 0) target = 1;
+    uint64_t cum = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        cum += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (cum >= target) {
+            uint64_t v = hist_value(i);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+void stats_init(stats_t *st, bool latency_enabled)
+{
+    memset(st, 0, sizeof(*st));
+    st->latency_enabled = latency_enabled;
+    clock_gettime(CLOCK_MONOTONIC, &st->started);
+    st->last_read = st->started;
+}
+
+static double elapsed_s(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) * 1e-9;
+}
+
+static size_t format_hist(char *buf, size_t len, const char *name, const hist_t *h)
+{
+    int n = snprintf(buf, len,
+                     "%s_count=%llu\n"
+                     "%s_p50_us=%.1f\n"
+                     "%s_p90_us=%.1f\n"
+                     "%s_p99_us=%.1f\n"
+                     "%s_p999_us=%.1f\n"
+                     "%s_max_us=%.1f\n",
+                     name, (unsigned long long)h->total,
+                     name, hist_percentile(h, 0.50) / 1e3,
+                     name, hist_percentile(h, 0.90) / 1e3,
+                     name, hist_percentile(h, 0.99) / 1e3,
+                     name, hist_percentile(h, 0.999) / 1e3,
+                     name, h->max / 1e3);
+    if (n < 0) return 0;
+    return (size_t)n < len ? (size_t)n : len - 1;
+}
+
+size_t stats_format(stats_t *st, char *buf, size_t len,
+                    const char *const *state_names, int nstates, const char *extra)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double up = elapsed_s(&st->started, &now);
+    double since = elapsed_s(&st->last_read, &now);
+    size_t off = 0;
+    int n;
+
+    if (len == 0) return 0;
+    // off は常に len - 1 以下 (末尾の '\0' の位置)。埋まったら以降は書かない
+    #define APPEND(...) do { \
+        if (off + 1 < len) { \
+            n = snprintf(buf + off, len - off, __VA_ARGS__); \
+            if (n > 0) off += ((size_t)n < len - off) ? (size_t)n : len - off - 1; \
+        } \
+    } while (0)
+
+    APPEND("uptime_s=%.3f\n", up);
+    APPEND("events=%lu\n", st->events);
+    APPEND("events_per_sec=%.1f\n", up > 0 ? st->events / up : 0.0);
+    APPEND("events_per_sec_recent=%.1f\n", since > 0 ? (st->events - st->last_events) / since : 0.0);
+    APPEND("syn_dropped=%lu\n", st->syn_dropped);
+    for (int i = 0; i < nstates && i < STATS_MAX_STATES; i++)
+        APPEND("frames_%s=%lu\n", state_names[i], st->frames[i]);
+    APPEND("wheel_frames=%lu\n", st->wheel_frames);
+    APPEND("wheel_reversals=%lu\n", st->wheel_reversals);
+    APPEND("syscalls_saved=%lu\n", st->syscalls_saved);
+    APPEND("passthrough_frames=%lu\n", st->pass_frames);
+    APPEND("passthrough_syscalls_saved=%lu\n", st->pass_syscalls_saved);
+    APPEND("catchup_batches=%lu\n", st->catchup_batches);
+    APPEND("coalesced_frames=%lu\n", st->coalesced_frames);
+    APPEND("mt_extra_frames=%lu\n", st->mt_extra_frames);
+    APPEND("mt_cancels=%lu\n", st->mt_cancels);
+    APPEND("resyncs=%lu\n", st->resyncs);
+    APPEND("resync_events=%lu\n", st->resync_events);
+    APPEND("resync_us_last=%.1f\n", st->resync_us_last);
+    APPEND("resync_us_max=%.1f\n", st->resync_us_max);
+    APPEND("reconnects=%lu\n", st->reconnects);
+    APPEND("reconnect_gap_ms_last=%.1f\n", st->reconnect_gap_ms_last);
+    APPEND("reconnect_gap_ms_max=%.1f\n", st->reconnect_gap_ms_max);
+    APPEND("reconnect_attach_ms_last=%.2f\n", st->reconnect_attach_ms_last);
+    APPEND("latency_enabled=%d\n", st->latency_enabled);
+    off += format_hist(buf + off, len - off, "passthrough_latency", &st->passthrough_ns);
+    off += format_hist(buf + off, len - off, "scroll_latency", &st->scroll_ns);
+    off += format_hist(buf + off, len - off, "time_to_first_scroll", &st->first_scroll_ns);
+    off += format_hist(buf + off, len - off, "step_lead", &st->step_lead_ns);
+    off += format_hist(buf + off, len - off, "step_lag", &st->step_lag_ns);
+    APPEND("predict_corrections=%lu\n", st->predict_corrections);
+    APPEND("kinetic_runs=%lu\n", st->kinetic_runs);
+    APPEND("kinetic_ticks=%lu\n", st->kinetic_ticks);
+    APPEND("kinetic_frames=%lu\n", st->kinetic_frames);
+    if (extra) APPEND("%s", extra);
+    #undef APPEND
+
+    st->last_events = st->events;
+    st->last_read = now;
+    return off;
+}
+
+int stats_server_open(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) return -ENAMETOOLONG;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -errno;
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+    return fd;
+}
+
+void stats_server_serve(int listen_fd, const char *text, size_t len)
+{
+    int c;
+    while ((c = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        // 数KB (STATS_TEXT_MAX 以下) なので普通はソケットバッファに一度で収まる。
+        // イベントスレッドで書くので、読まないクライアントでも待たずに残りを捨てて閉じる
+        const char *p = text;
+        size_t left = len;
+        while (left > 0) {
+            ssize_t w = write(c, p, left);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            p += w;
+            left -= (size_t)w;
+        }
+        close(c);
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef WCIRCLE_STATS_H
+#define WCIRCLE_STATS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * HDR 風の対数線形ヒストグラム。2のべき乗ごとに HIST_SUB 個へ分割するので
+ * 相対誤差は 1/HIST_SUB 以下。値 [ns] は 2^HIST_MAX_EXP 未満に丸める。
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP  40
+#define HIST_BUCKETS  ((HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB)
+
+/*
+ * pipeline=1 では読み取りスレッドとジェスチャスレッドが別々のカウンタを書き、
+ * 読み取りスレッドの stats_format がそれを読むので、カウンタは relaxed な atomic にする。
+ * 各カウンタを書くのは1スレッドだけなので、加算は lock 命令の要らない load + store で足りる。
+ */
+typedef _Atomic unsigned long stats_counter_t;
+
+static inline void stats_add(stats_counter_t *c, unsigned long n)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+typedef struct {
+    _Atomic uint64_t counts[HIST_BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+} hist_t;
+
+#define STATS_MAX_STATES 8
+#define STATS_TEXT_MAX   8192   // stats_format の出力 (約100行) が桁の多い値でも収まる大きさ
+
+typedef struct {
+    hist_t passthrough_ns;    // ev.time から passthrough 書き込みまで
+    hist_t scroll_ns;         // フレームの ev.time から REL_WHEEL 書き込みまで
+    // 以下は ev.time 同士の差なので --replay でも測れる
+    hist_t first_scroll_ns;   // BTN_TOUCH 1 から最初のホイールフレームまで
+    hist_t step_lead_ns;      // 出力したステップが指の回転より先行した時間
+    hist_t step_lag_ns;       // 出力したステップが指の回転より遅れた時間
+    stats_counter_t predict_corrections;     // 予測で行き過ぎて逆向きに戻したステップ数
+    stats_counter_t kinetic_runs;            // 指を離した後に慣性スクロールを始めた回数
+    stats_counter_t kinetic_ticks;           // 慣性のタイマー処理の回数
+    stats_counter_t kinetic_frames;          // 慣性で送出したホイールフレーム数
+    atomic_bool latency_enabled;             // ev.time が CLOCK_MONOTONIC のときのみ計測
+    stats_counter_t events;
+    stats_counter_t syn_dropped;
+    stats_counter_t frames[STATS_MAX_STATES];  // SYN_REPORT 時点の状態別フレーム数
+    stats_counter_t wheel_frames;            // 送出したホイールフレーム数
+    stats_counter_t wheel_reversals;         // 1回の接触中に前のホイールフレームと逆向きになった回数
+    stats_counter_t syscalls_saved;          // ホイールのまとめ書きで削減できた write 回数
+    stats_counter_t pass_frames;             // passthrough で書いたフレーム数 (= write 回数)
+    stats_counter_t pass_syscalls_saved;     // passthrough をフレーム単位にして削減できた write 回数
+    stats_counter_t catchup_batches;         // 溜まったフレームが閾値を超えていた読み取り回数
+    stats_counter_t coalesced_frames;        // 追いつきモードで角度計算を省いたフレーム数
+    stats_counter_t mt_extra_frames;         // ジェスチャ中に他の指も触れていたフレーム数
+    stats_counter_t mt_cancels;              // 他の指が触れたのでジェスチャを終えた回数
+    stats_counter_t resyncs;                 // SYN_DROPPED から同期し直した回数
+    stats_counter_t resync_events;           // 同期で受け取ったイベント数
+    // 以下の double は読み取りスレッドだけが書いて読むので atomic にしない
+    double resync_us_last;                   // 直近の同期にかかった時間
+    double resync_us_max;
+    stats_counter_t reconnects;              // 切断後に再接続できた回数
+    double reconnect_gap_ms_last;            // 直近の再接続: 切断から復帰までの時間
+    double reconnect_gap_ms_max;
+    double reconnect_attach_ms_last;         // 直近の再接続: open/grab 等にかかった時間
+    struct timespec started;
+    unsigned long last_events;               // 前回読み出し時の events
+    struct timespec last_read;
+} stats_t;
+
+void     hist_record(hist_t *h, uint64_t v);
+uint64_t hist_percentile(const hist_t *h, double p);
+
+void stats_init(stats_t *st, bool latency_enabled);
+
+static inline int64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* カーネルタイムスタンプ [us] から現在までの遅延を h に記録する */
+static inline void stats_latency(stats_t *st, hist_t *h, int64_t ev_us)
+{
+    if (!atomic_load_explicit(&st->latency_enabled, memory_order_relaxed)) return;
+    int64_t d = stats_now_ns() - ev_us * 1000;
+    hist_record(h, d > 0 ? (uint64_t)d : 0);
+}
+
+/*
+ * key=value 形式でテキスト化する。state_names[i] は frames[i] の名前。
+ * 追加の行 (extra) はそのまま末尾に付ける。書いた長さを返す (len に収まらない分は切り捨てる)。
+ */
+size_t stats_format(stats_t *st, char *buf, size_t len,
+                    const char *const *state_names, int nstates, const char *extra);
+
+/* 統計読み出し用の Unix ソケットを作る。失敗で -errno */
+int  stats_server_open(const char *path);
+/* 待っている接続を受け付けて text を書いて閉じる。書けない分は待たずに捨てる */
+void stats_server_serve(int listen_fd, const char *text, size_t len);
+
+#endif /* WCIRCLE_STATS_H */
@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libevdev-1.0/libevdev/libevdev.h>
+#include "synth.h"
+
+#define TAP_SEC       0.04   // タップの接触時間
+#define EXIT_SEC      0.15   // exit で内側へ抜けるのにかける時間
+#define EXIT_TURNS    0.5    // exit で抜ける前に回る量
+#define EXIT_RADIUS   0.2    // exit の終点 (中央付近)
+#define TAP_RADIUS    0.05
+#define LONG_FACTOR   10
+#define TWO_ID_BASE   10000  // two: 2本目の指の ABS_MT_TRACKING_ID
+
+static const struct {
+    const char *name;
+    synth_kind_t kind;
+} kind_names[] = {
+    { "spin", SYNTH_SPIN },
+    { "long", SYNTH_LONG },
+    { "tap",  SYNTH_TAP  },
+    { "exit", SYNTH_EXIT },
+    { "two",  SYNTH_TWO  },
+};
+
+static int parse_pattern(synth_config_t *cfg, const char *val)
+{
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "%s", val);
+    cfg->npattern = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(tmp, "+", &save); tok; tok = strtok_r(NULL, "+", &save)) {
+        size_t i;
+        for (i = 0; i < sizeof(kind_names) / sizeof(kind_names[0]); i++)
+            if (strcmp(tok, kind_names[i].name) == 0) break;
+        if (i == sizeof(kind_names) / sizeof(kind_names[0])) return -EINVAL;
+        if (cfg->npattern == SYNTH_PATTERN_MAX) return -EINVAL;
+        cfg->pattern[cfg->npattern++] = kind_names[i].kind;
+    }
+    return cfg->npattern > 0 ? 0 : -EINVAL;
+}
+
+static int parse_range(struct input_absinfo *abs, const char *val)
+{
+    int lo, hi;
+    if (sscanf(val, "%d:%d", &lo, &hi) != 2 || hi <= lo) return -EINVAL;
+    abs->minimum = lo;
+    abs->maximum = hi;
+    return 0;
+}
+
+int synth_parse(synth_config_t *cfg, const char *spec)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->rate_hz = 125;
+    cfg->radius  = 0.9;
+    cfg->speed   = 1.5;
+    cfg->turns   = 1.5;
+    cfg->jitter  = 0.002;
+    cfg->gap_ms  = 150;
+    cfg->count   = 20;
+    cfg->seed    = 1;
+    cfg->abs_x.maximum = 1216;
+    cfg->abs_y.maximum = 680;
+    parse_pattern(cfg, "spin+tap+exit+long");
+
+    char *tmp = strdup(spec ? spec : "");
+    if (!tmp) return -ENOMEM;
+    int rc = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(tmp, ",", &save); tok && rc == 0; tok = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(tok, '=');
+        if (!val) { rc = -EINVAL; break; }
+        *val++ = '\0';
+        if      (strcmp(tok, "rate") == 0)    cfg->rate_hz = atoi(val);
+        else if (strcmp(tok, "radius") == 0)  cfg->radius  = atof(val);
+        else if (strcmp(tok, "speed") == 0)   cfg->speed   = atof(val);
+        else if (strcmp(tok, "turns") == 0)   cfg->turns   = atof(val);
+        else if (strcmp(tok, "jitter") == 0)  cfg->jitter  = atof(val);
+        else if (strcmp(tok, "gap") == 0)     cfg->gap_ms  = atof(val);
+        else if (strcmp(tok, "count") == 0)   cfg->count   = atoi(val);
+        else if (strcmp(tok, "seed") == 0)    cfg->seed    = strtoul(val, NULL, 10);
+        else if (strcmp(tok, "pattern") == 0) rc = parse_pattern(cfg, val);
+        else if (strcmp(tok, "x") == 0)       rc = parse_range(&cfg->abs_x, val);
+        else if (strcmp(tok, "y") == 0)       rc = parse_range(&cfg->abs_y, val);
+        else if (strcmp(tok, "dev") == 0)     snprintf(cfg->device, sizeof(cfg->device), "%s", val);
+        else rc = -EINVAL;
+    }
+    free(tmp);
+    if (rc < 0) return rc;
+
+    if (cfg->rate_hz < 1 || cfg->rate_hz > SYNTH_MAX_RATE) return -EINVAL;
+    if (cfg->radius <= 0 || cfg->speed <= 0 || cfg->turns <= 0) return -EINVAL;
+    if (cfg->jitter < 0 || cfg->gap_ms < 0 || cfg->count < 1) return -EINVAL;
+    return 0;
+}
+
+// 接触しているフレーム数 (exit は外周を回る分を arc に返す)
+static int touch_frames(const synth_config_t *cfg, synth_kind_t kind, int *arc)
+{
+    double rate = cfg->rate_hz;
+    int n;
+    *arc = 0;
+    switch (kind) {
+    case SYNTH_LONG:
+        n = (int)lround(cfg->turns * LONG_FACTOR / cfg->speed * rate);
+        break;
+    case SYNTH_TAP:
+        n = (int)lround(TAP_SEC * rate);
+        break;
+    case SYNTH_EXIT:
+        *arc = (int)lround(EXIT_TURNS / cfg->speed * rate);
+        if (*arc < 1) *arc = 1;
+        n = *arc + (int)lround(EXIT_SEC * rate);
+        break;
+    default:
+        n = (int)lround(cfg->turns / cfg->speed * rate);
+        break;
+    }
+    int min = kind == SYNTH_TWO ? 3 : 2;   // two は1本目だけ → 2本 → 1本だけ
+    return n < min ? min : n;
+}
+
+double synth_duration(const synth_config_t *cfg)
+{
+    double sec = 0;
+    for (int i = 0; i < cfg->count; i++) {
+        int arc;
+        // 接触中 + 離すフレーム + 空き
+        sec += (touch_frames(cfg, cfg->pattern[i % cfg->npattern], &arc) + 1.0) / cfg->rate_hz;
+        sec += cfg->gap_ms * 1e-3;
+    }
+    return sec;
+}
+
+// xorshift64*
+static double rand_uniform(synth_t *g)
+{
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return ((g->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rand_gauss(synth_t *g)
+{
+    double u = rand_uniform(g), v = rand_uniform(g);
+    if (u < 1e-12) u = 1e-12;
+    return sqrt(-2.0 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void start_gesture(synth_t *g)
+{
+    synth_kind_t kind = g->cfg.pattern[g->gesture % g->cfg.npattern];
+    g->frame = 0;
+    g->nframes = touch_frames(&g->cfg, kind, &g->arc_frames);
+    g->two_on = g->two_off = -1;
+    if (kind == SYNTH_TWO) {
+        g->two_on = g->nframes / 3 > 0 ? g->nframes / 3 : 1;
+        g->two_off = g->nframes * 2 / 3 > g->two_on ? g->nframes * 2 / 3 : g->two_on + 1;
+    }
+    g->ang0 = rand_uniform(g) * 2 * M_PI;
+    g->dir = (g->gesture / g->cfg.npattern) % 2 ? -1.0 : 1.0;   // 一巡ごとに逆回り
+}
+
+static void position(synth_t *g, int *x, int *y)
+{
+    const synth_config_t *c = &g->cfg;
+    synth_kind_t kind = c->pattern[g->gesture % c->npattern];
+    double r = c->radius, th;
+    double spin = g->dir * 2 * M_PI * c->speed / c->rate_hz;
+
+    if (kind == SYNTH_TAP) {
+        r = TAP_RADIUS;
+        th = g->ang0;
+    } else if (kind == SYNTH_EXIT && g->frame >= g->arc_frames) {
+        double k = (double)(g->frame - g->arc_frames + 1) / (g->nframes - g->arc_frames);
+        r = c->radius + (EXIT_RADIUS - c->radius) * k;
+        th = g->ang0 + spin * g->arc_frames;
+    } else {
+        th = g->ang0 + spin * g->frame;
+    }
+
+    double hx = (c->abs_x.maximum - c->abs_x.minimum) / 2.0;
+    double hy = (c->abs_y.maximum - c->abs_y.minimum) / 2.0;
+    double fx = c->abs_x.minimum + hx + r * hx * cos(th) + rand_gauss(g) * c->jitter * 2 * hx;
+    double fy = c->abs_y.minimum + hy + r * hy * sin(th) + rand_gauss(g) * c->jitter * 2 * hy;
+    *x = (int)lround(fx);
+    *y = (int)lround(fy);
+    if (*x < c->abs_x.minimum) *x = c->abs_x.minimum;
+    if (*x > c->abs_x.maximum) *x = c->abs_x.maximum;
+    if (*y < c->abs_y.minimum) *y = c->abs_y.minimum;
+    if (*y > c->abs_y.maximum) *y = c->abs_y.maximum;
+}
+
+void synth_init(synth_t *g, const synth_config_t *cfg, bool realtime)
+{
+    memset(g, 0, sizeof(*g));
+    g->cfg = *cfg;
+    g->realtime = realtime;
+    g->rng = 0x9E3779B97F4A7C15ULL ^ cfg->seed;
+    if (g->rng == 0) g->rng = 1;
+    start_gesture(g);
+}
+
+static void put(synth_t *g, int type, int code, int value)
+{
+    struct input_event *ev = &g->buf[g->n++];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+// 次のフレームを buf に作る。変化の無いフレームはカーネル同様に出さない
+static bool next_frame(synth_t *g, double *frame_us)
+{
+    double period = 1e6 / g->cfg.rate_hz;
+    for (;;) {
+        if (g->gesture >= g->cfg.count) return false;
+        g->n = 0;
+        g->pos = 0;
+        *frame_us = g->t_us;
+
+        if (g->frame < g->nframes) {
+            int x, y;
+            position(g, &x, &y);
+            if (g->frame == 0) {
+                put(g, EV_ABS, ABS_MT_SLOT, 0);
+                put(g, EV_ABS, ABS_MT_TRACKING_ID, g->gesture + 1);
+                put(g, EV_ABS, ABS_MT_POSITION_X, x);
+                put(g, EV_ABS, ABS_MT_POSITION_Y, y);
+                put(g, EV_KEY, BTN_TOUCH, 1);
+                put(g, EV_KEY, BTN_TOOL_FINGER, 1);
+                put(g, EV_ABS, ABS_X, x);
+                put(g, EV_ABS, ABS_Y, y);
+            } else {
+                // two: 2本目の指は中央に止めておく (乱数を使わないので1本目の軌跡は spin と同じ)
+                bool down = g->frame == g->two_on, up = g->frame == g->two_off;
+                if (down || up) {
+                    put(g, EV_ABS, ABS_MT_SLOT, 1);
+                    put(g, EV_ABS, ABS_MT_TRACKING_ID, down ? TWO_ID_BASE + g->gesture : -1);
+                    if (down) {
+                        put(g, EV_ABS, ABS_MT_POSITION_X, (g->cfg.abs_x.minimum + g->cfg.abs_x.maximum) / 2);
+                        put(g, EV_ABS, ABS_MT_POSITION_Y, (g->cfg.abs_y.minimum + g->cfg.abs_y.maximum) / 2);
+                    }
+                    put(g, EV_ABS, ABS_MT_SLOT, 0);
+                }
+                if (x != g->last_x) put(g, EV_ABS, ABS_MT_POSITION_X, x);
+                if (y != g->last_y) put(g, EV_ABS, ABS_MT_POSITION_Y, y);
+                if (down || up) {
+                    put(g, EV_KEY, BTN_TOOL_FINGER, up);
+                    put(g, EV_KEY, BTN_TOOL_DOUBLETAP, down);
+                }
+                // ABS_X/Y は1本目の指を追う
+                if (x != g->last_x) put(g, EV_ABS, ABS_X, x);
+                if (y != g->last_y) put(g, EV_ABS, ABS_Y, y);
+            }
+            g->last_x = x;
+            g->last_y = y;
+            g->frame++;
+            g->t_us += period;
+        } else {
+            put(g, EV_ABS, ABS_MT_TRACKING_ID, -1);
+            put(g, EV_KEY, BTN_TOUCH, 0);
+            put(g, EV_KEY, BTN_TOOL_FINGER, 0);
+            g->t_us += period + g->cfg.gap_ms * 1000;
+            g->gesture++;
+            if (g->gesture < g->cfg.count) start_gesture(g);
+        }
+        if (g->n == 0) continue;
+        put(g, EV_SYN, SYN_REPORT, 0);
+        return true;
+    }
+}
+
+static void stamp(synth_t *g, int64_t sec, int64_t usec)
+{
+    for (int i = 0; i < g->n; i++) {
+        g->buf[i].input_event_sec = sec;
+        g->buf[i].input_event_usec = usec;
+    }
+}
+
+int synth_next_event(synth_t *g, unsigned int flags, struct input_event *ev)
+{
+    if (flags & LIBEVDEV_READ_FLAG_SYNC) return -EAGAIN;
+
+    if (g->pos == g->n && !g->held) {
+        double frame_us;
+        if (!next_frame(g, &frame_us)) return -ENODATA;
+        if (!g->realtime) {
+            // 録画ファイルと同じく 1 s から始まる時刻を付ける
+            int64_t t = 1000000 + (int64_t)frame_us;
+            stamp(g, t / 1000000, t % 1000000);
+        } else {
+            if (!g->started) {
+                clock_gettime(CLOCK_MONOTONIC, &g->start_ts);
+                g->started = true;
+            }
+            int64_t off_ns = (int64_t)(frame_us * 1000);
+            struct timespec due = g->start_ts;
+            due.tv_sec  += off_ns / 1000000000;
+            due.tv_nsec += off_ns % 1000000000;
+            if (due.tv_nsec >= 1000000000) { due.tv_sec++; due.tv_nsec -= 1000000000; }
+            stamp(g, due.tv_sec, due.tv_nsec / 1000);
+
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t lag_us = (now.tv_sec - due.tv_sec) * 1000000 + (now.tv_nsec - due.tv_nsec) / 1000;
+            if (lag_us < 0) {
+                // まだ届いていない: 実機で読み切ったのと同じく一度 -EAGAIN
+                g->held = true;
+                return -EAGAIN;
+            }
+            if (lag_us > g->max_lag_us) g->max_lag_us = lag_us;
+            if (lag_us > 1000000 / g->cfg.rate_hz) g->late_frames++;
+        }
+        g->frames++;
+    } else if (g->held) {
+        struct timespec due = {
+            .tv_sec  = g->buf[0].input_event_sec,
+            .tv_nsec = g->buf[0].input_event_usec * 1000,
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+            ;
+        g->held = false;
+        g->frames++;
+    }
+
+    *ev = g->buf[g->pos++];
+    g->events++;
+    return LIBEVDEV_READ_STATUS_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#ifndef WCIRCLE_SYNTH_H
+#define WCIRCLE_SYNTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/input.h>
+
+/*
+ * 負荷試験用の合成タッチパッド入力。
+ * 実機と同じ並び (ABS_MT_* → BTN_* → ABS_X/Y → SYN_REPORT) のフレームを
+ * 指定レートで作り、libevdev_next_event() 互換で返す。
+ *
+ * 仕様文字列は key=value を ',' でつないだもの:
+ *   rate=HZ      報告レート (1..1000)                      既定 125
+ *   radius=R     回転の半径 (パッドの縁に内接する楕円 = 1.0)  既定 0.9
+ *   speed=RPS    角速度 [回転/s]                            既定 1.5
+ *   turns=N      spin 1回の回転数 (long はこの10倍)         既定 1.5
+ *   jitter=J     位置の揺らぎの標準偏差 (パッド幅比)        既定 0.002
+ *   gap=MS       ジェスチャ間で指を離している時間 [ms]      既定 150
+ *   count=N      ジェスチャ数 (pattern を繰り返す)          既定 20
+ *   pattern=P    spin|long|tap|exit|two を '+' でつないだもの 既定 spin+tap+exit+long
+ *   seed=N       揺らぎと開始角の乱数の種                    既定 1
+ *   x=MIN:MAX, y=MIN:MAX  ABS_X/ABS_Y の範囲                既定 0:1216, 0:680
+ *   dev=PATH     範囲を実機の absinfo から取る (呼び出し側が読む)
+ */
+
+#define SYNTH_MAX_RATE    1000
+#define SYNTH_PATTERN_MAX 16
+
+typedef enum {
+    SYNTH_SPIN,   // 外周を turns 回転して離す
+    SYNTH_LONG,   // turns の10倍回し続ける
+    SYNTH_TAP,    // 中央付近を短く叩く
+    SYNTH_EXIT,   // 半回転したあと内側へ抜ける (ジェスチャ途中のエリア外)
+    SYNTH_TWO,    // spin の途中 (1/3〜2/3) だけ2本目の指を中央に置く (スロット1)
+} synth_kind_t;
+
+typedef struct {
+    int    rate_hz;
+    double radius;
+    double speed;
+    double turns;
+    double jitter;
+    double gap_ms;
+    int    count;
+    synth_kind_t pattern[SYNTH_PATTERN_MAX];
+    int    npattern;
+    unsigned seed;
+    struct input_absinfo abs_x, abs_y;
+    char   device[256];   // dev= の指定 (空なら abs_x/abs_y をそのまま使う)
+} synth_config_t;
+
+typedef struct {
+    synth_config_t cfg;
+    bool realtime;              // レートどおりに間隔を空けて返す (時刻は CLOCK_MONOTONIC)
+    uint64_t rng;
+    double t_us;                // 次のフレームの時刻 (開始からの経過)
+    int gesture;                // 現在のジェスチャ番号
+    int frame;                  // ジェスチャ内のフレーム番号 (接触中)
+    int nframes;                // 接触しているフレーム数
+    int arc_frames;             // exit: 外周を回るフレーム数
+    int two_on, two_off;        // two: 2本目の指が触れる/離れるフレーム (他は -1)
+    double ang0, dir;           // 開始角 [rad]・回転方向
+    int last_x, last_y;
+    struct input_event buf[16]; // 作成済みのフレーム
+    int n, pos;
+    bool started, held;
+    struct timespec start_ts;
+    // 統計
+    unsigned long events;       // 返したイベント数
+    unsigned long frames;       // 返したフレーム数
+    unsigned long late_frames;  // realtime で1周期以上遅れて取り出されたフレーム数
+    int64_t max_lag_us;         // realtime で予定時刻から遅れた最大値
+} synth_t;
+
+/* cfg を既定値で埋めてから spec を適用する。不正な指定は -EINVAL */
+int  synth_parse(synth_config_t *cfg, const char *spec);
+void synth_init(synth_t *g, const synth_config_t *cfg, bool realtime);
+/*
+ * libevdev_next_event() と同じ戻り値。すべて出し終えたら -ENODATA。
+ * realtime ではまだ時刻になっていないフレームに一度 -EAGAIN を返し、次の呼び出しで待つ。
+ * SYN_DROPPED は起こさないので、同期読み出しは常に -EAGAIN。
+ */
+int  synth_next_event(synth_t *g, unsigned int flags, struct input_event *ev);
+/* 全体の長さ [s] (ジェスチャ間の空きを含む) */
+double synth_duration(const synth_config_t *cfg);
+
+#endif /* WCIRCLE_SYNTH_H */
@@ -8,47 +8,157 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include <libevdev-1.0/libevdev/libevdev.h>
 #include <libevdev-1.0/libevdev/libevdev-uinput.h>
 #include <dirent.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include "../inih/ini.h"
+#include "discover.h"
+#include "engine.h"
+#include "log.h"
+#include "pipeline.h"
+#include "replay.h"
+#include "rt.h"
+#include "sink.h"
+#include "stats.h"
+#include "synth.h"
 
-#define DIE(...)  do { fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); exit(1);} while(0)
-
-#define LOG(...) do { \
-    time_t t = time(NULL); \
-    struct tm *tm_info = localtime(&t); \
-    char time_buf[20]; \
-    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info); \
-    fprintf(stderr, "[%s] [DEBUG] ", time_buf); \
-    fprintf(stderr, __VA_ARGS__); \
-    fprintf(stderr, "\n"); \
-} while(0)
+#define DIE(...)  do { log_flush(); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); exit(1);} while(0)
 
 #define DEG2RAD M_PI/180
 #define RAD2DEG 180/M_PI
 
+#define MAX_EPOLL_EVENTS 8   // epoll_wait 1回で受け取る最大 fd 数
+#define MAX_PADS 8           // 1プロセスで扱うタッチパッドの最大数
+
+// epoll に登録する fd の識別子 (data.u64)。0..MAX_PADS-1 はタッチパッド
+#define EP_STATS   MAX_PADS
+#define EP_HOTPLUG (MAX_PADS + 1)
+#define EP_KINETIC (MAX_PADS + 2)   // EP_KINETIC + i は pads[i] の慣性タイマー
+#define DEFAULT_STATS_SOCKET "/run/wcircle.sock"
+#define DEFAULT_DEVICE_CACHE "/var/cache/wcircle/devices"
+#define DEFAULT_PIPELINE_RING 256
+#define PASS_FRAME_MAX 64    // passthrough で1回の write にまとめる最大イベント数
+#define DRAIN_BATCH 512      // 1回にまとめて読むイベント数
+#define CATCHUP_MAX_US 20000 // 追いつきモードで1つにまとめる最長の時間 [us] (速く回しても半周にかかる時間よりずっと短く)
+#define DEFAULT_CATCHUP_FRAMES 8
+#define STEP_LEVELS 64       // ステップのタイミング計測で覚えておく累計値の数
+
 typedef struct {
-    char* pad_device_path;    // タッチパッドデバイスのパス
+    char* pad_device_path;    // タッチパッドデバイスのパス (カンマ区切りで複数可)
     double outer_ratio_min;   // 外周リングの内側境界（中心からの比）
     double outer_ratio_max;   // 外周リングの外側境界（比)
     double start_arc_rad;     // スクロール開始判定: 累積角度 [rad]
     double step_rad;          // 1ホイール発火あたりの角度 [rad]（小さくすると高分解能）
     int    wheel_step;        // REL_WHEEL の1発あたり値（一般的には ±1）
-    int    wheel_hi_res;      // 高解像度を用いるか否か(1=REL_WHEEL_HI_RES, 0=REL_WHEEL)
+    int    wheel_hi_res;      // 1=REL_WHEEL_HI_RES を毎フレーム出し、REL_WHEEL は120ごとに合成, 0=REL_WHEEL のみ
     int    invert_scroll;     // 0=時計回りで下、1=時計回りで上
+    double predict_ms;        // 角速度からこの時間だけ先回りしてステップを出す (0で無効)
+    double kinetic_ms;        // 慣性スクロールの減衰の時定数 (0で無効)
+    double kinetic_min_rad_s; // 慣性を始める/止める角速度
+    int    kinetic_tick_ms;   // 慣性の回転を出す間隔
+    int    accel_points;      // 加速カーブ (0点で無効)
+    double accel_dps[ENGINE_ACCEL_POINTS];
+    double accel_gain[ENGINE_ACCEL_POINTS];
+    double filter_min_cutoff; // 位置の One-Euro フィルタの最低遮断周波数 [Hz] (0で無効)
+    double filter_beta;       // 速さに応じて遮断周波数を上げる係数
+    double reverse_rad;       // スクロール中の逆回転のヒステリシス (0で無効)
+    engine_mt_mode_t multi_touch; // ジェスチャを始めた指だけを追う / 2本目で終える / MT を見ない
     int    all_wheel;         // 
+    char*  stats_socket;      // 統計読み出し用 Unix ソケット (空文字で無効)
+    int    log_level;         // LOG_LVL_ERROR..LOG_LVL_DEBUG
+    char*  device_cache;      // 自動検出結果のキャッシュファイル (空文字で無効)
+    int    pipeline;          // 1=読み取り/passthrough とジェスチャ処理を別スレッドにする
+    int    pipeline_ring;     // スレッド間のフレームキューの段数
+    int    catchup_frames;    // 溜まったフレームがこれを超えたら位置だけのフレームをまとめる (0で無効)
+    int    rt_mode;           // 1=低遅延モード (SCHED_FIFO・mlockall 等)
+    rt_config_t rt;
 } config_t;
 
+// engine_state_t の順
+static const char *const state_names[] = {
+    "none", "first", "started_in_area", "started_not_in_area", "scrolling", "end",
+};
+
 typedef struct {
     int x_min, x_max, y_min, y_max;
-    double last_angle;     // unwrap 済みの直前角
-    double accum_angle;    // 累積角
-    bool staying_in_area;  // 開始判定エリアに留まっているか(開始判定用)
-    bool scrolling;        // スクロールモード中か
+    int curr_x, curr_y;    // 最新の ABS_X / ABS_Y
+    uint32_t frame_flags;  // SYN_REPORT までに見た ENGINE_TOUCH_* / ENGINE_NEW_CONTACT
+    engine_t eng;          // リング判定と回転角の積算 (I/O はしない)
+    int32_t out_level, act_level;        // 出力したステップ / 予測しない場合のステップの累計
+    int wheel_dir;                       // この接触で最後に出したホイールの向き (0 = まだ無い)
+    int64_t out_reach[2][STEP_LEVELS];   // 累計がその値に [上向き, 下向き] で着いた時刻
+    int64_t act_reach[2][STEP_LEVELS];
+    int64_t frame_us;      // 処理中フレームのカーネルタイムスタンプ [us]
+    atomic_bool suppress;  // SCROLLING 中 (passthrough を止める)。pipeline では別スレッドから読む
+    struct input_event pass[PASS_FRAME_MAX]; // SYN_REPORT まで溜めている passthrough
+    size_t npass;
+    pipeline_t *pipe;      // NULL なら読み取りスレッドでジェスチャも処理する
+    pipe_frame_t pending;  // pipeline: SYN_REPORT まで溜めているフレーム
+    bool pending_must;     // pending に BTN_TOUCH か MT のスロット/接触の変化が含まれる (捨てられない)
+    bool catchup;          // 読み取り側: このフレームの角度計算を次のフレームに任せてよい
+    bool coalesce;         // ジェスチャ側: 同上 (pipeline ではフレームと一緒に渡す)
+    bool resyncing;        // 読み取り側: SYN_DROPPED 後の同期イベントを処理している
+    bool in_resync;        // ジェスチャ側: 同上
+    int kinetic_fd;        // 慣性のタイマー (慣性中だけ動かす)。-1 なら入力の時刻で進める (replay)
+    bool kinetic_armed;
+    sink_t *pad_out;       // passthrough 先
+    sink_t *mouse_out;     // スクロール出力先 (全タッチパッドで共有)
+    stats_t *stats;        // 統計 (全タッチパッドで共有)
     config_t cfg;
 } app_t;
 
+// 加速カーブのプリセット (角速度 [deg/s] : 倍率)
+typedef struct {
+    const char *name;
+    int n;
+    double dps[ENGINE_ACCEL_POINTS];
+    double gain[ENGINE_ACCEL_POINTS];
+} accel_preset_t;
+
+static const accel_preset_t accel_presets[] = {
+    { "off",     0, {0},                   {0} },
+    { "precise", 3, {0, 120, 480},         {0.5, 1, 1.5} },   // ゆっくり回すと1行ずつ送りやすい
+    { "gentle",  3, {90, 360, 1080},       {1, 2, 3} },
+    { "fast",    4, {60, 240, 720, 1440},  {1, 2.5, 5, 8} },  // 長いファイルを速く送る
+};
+
+/* accel= の値: プリセット名か "dps:gain,dps:gain,..." (角速度の昇順)。不正なら false */
+static bool parse_accel(config_t *cfg, const char *value){
+    for (size_t i = 0; i < sizeof(accel_presets) / sizeof(accel_presets[0]); i++) {
+        const accel_preset_t *p = &accel_presets[i];
+        if (strcmp(value, p->name) != 0) continue;
+        cfg->accel_points = p->n;
+        memcpy(cfg->accel_dps, p->dps, sizeof(p->dps));
+        memcpy(cfg->accel_gain, p->gain, sizeof(p->gain));
+        return true;
+    }
+    int n = 0;
+    const char *s = value;
+    while (*s) {
+        char *end;
+        double dps = strtod(s, &end);
+        if (end == s || *end != ':' || n == ENGINE_ACCEL_POINTS) return false;
+        s = end + 1;
+        double gain = strtod(s, &end);
+        if (end == s || gain < 0 || (n > 0 && dps <= cfg->accel_dps[n - 1])) return false;
+        cfg->accel_dps[n] = dps;
+        cfg->accel_gain[n] = gain;
+        n++;
+        s = end;
+        while (*s == ',' || *s == ' ') s++;
+    }
+    if (n == 0) return false;
+    cfg->accel_points = n;
+    return true;
+}
+
 static int handler(void* config, const char* section, const char* name,
                    const char* value)
 {
@@ -71,8 +181,54 @@ static int handler(void* config, const char* section, const char* name,
         pconfig->wheel_hi_res = atoi(value);
     } else if (MATCH("wcircle", "invert_scroll")) {
         pconfig->invert_scroll = atoi(value);
+    } else if (MATCH("wcircle", "predict_ms")) {
+        pconfig->predict_ms = atof(value);
+    } else if (MATCH("wcircle", "kinetic_ms")) {
+        pconfig->kinetic_ms = atof(value);
+    } else if (MATCH("wcircle", "kinetic_min_dps")) {
+        pconfig->kinetic_min_rad_s = atof(value)*DEG2RAD;
+    } else if (MATCH("wcircle", "kinetic_tick_ms")) {
+        pconfig->kinetic_tick_ms = atoi(value);
+    } else if (MATCH("wcircle", "filter_min_cutoff")) {
+        pconfig->filter_min_cutoff = atof(value);
+    } else if (MATCH("wcircle", "filter_beta")) {
+        pconfig->filter_beta = atof(value);
+    } else if (MATCH("wcircle", "reverse_deg")) {
+        pconfig->reverse_rad = atof(value)*DEG2RAD;
+    } else if (MATCH("wcircle", "multi_touch")) {
+        if (strcmp(value, "off") == 0) pconfig->multi_touch = ENGINE_MT_OFF;
+        else if (strcmp(value, "ignore") == 0) pconfig->multi_touch = ENGINE_MT_IGNORE;
+        else if (strcmp(value, "cancel") == 0) pconfig->multi_touch = ENGINE_MT_CANCEL;
+        else LOG_WARN("Invalid multi_touch '%s' (off / ignore / cancel)", value);
+    } else if (MATCH("wcircle", "accel")) {
+        if (!parse_accel(pconfig, value)) {
+            LOG_WARN("Invalid accel '%s'; acceleration is disabled.", value);
+            pconfig->accel_points = 0;
+        }
     } else if (MATCH("wcircle", "all_wheel")) {
         pconfig->all_wheel = atoi(value);
+    } else if (MATCH("wcircle", "stats_socket")) {
+        pconfig->stats_socket = strdup(value);
+    } else if (MATCH("wcircle", "device_cache")) {
+        pconfig->device_cache = strdup(value);
+    } else if (MATCH("wcircle", "pipeline")) {
+        pconfig->pipeline = atoi(value);
+    } else if (MATCH("wcircle", "pipeline_ring")) {
+        pconfig->pipeline_ring = atoi(value);
+    } else if (MATCH("wcircle", "catchup_frames")) {
+        pconfig->catchup_frames = atoi(value);
+    } else if (MATCH("wcircle", "rt_mode")) {
+        pconfig->rt_mode = atoi(value);
+    } else if (MATCH("wcircle", "rt_priority")) {
+        pconfig->rt.priority = atoi(value);
+    } else if (MATCH("wcircle", "rt_cpu")) {
+        pconfig->rt.cpu = atoi(value);
+    } else if (MATCH("wcircle", "rt_prefault_kb")) {
+        pconfig->rt.prefault_kb = atoi(value);
+    } else if (MATCH("wcircle", "log_level")) {
+        int lvl = log_level_from_string(value);
+        if (lvl >= 0) pconfig->log_level = lvl;
+        else LOG_WARN("Invalid log_level '%s' (error / warn / info / debug)", value);
     } else {
         return 0;
     }
@@ -104,6 +260,8 @@ struct libevdev_uinput* create_virtual_mouse(void)
     libevdev_enable_event_code(dev, EV_REL, REL_X, NULL);
     libevdev_enable_event_code(dev, EV_REL, REL_Y, NULL);
     libevdev_enable_event_code(dev, EV_REL, REL_WHEEL, NULL);
+    // 高解像度に対応したクライアントは REL_WHEEL_HI_RES を使い、REL_WHEEL は無視する
+    libevdev_enable_event_code(dev, EV_REL, REL_WHEEL_HI_RES, NULL);
 
     // uinput 仮想デバイス作成
     rc = libevdev_uinput_create_from_device(dev,
@@ -131,14 +289,23 @@ static int is_touchpad(struct libevdev *dev) {
     return 0;
 }
 
-static char* get_touchpad_device_path(void) {
+static int cmp_path(const void *a, const void *b) {
+    return strverscmp((const char *)a, (const char *)b);
+}
+
+/*
+ * 条件に合う event* ノードを最大 max 個 paths に入れ、その数を返す (番号順)。
+ * 全ノードを開くので遅い。sysfs が読めないときの予備。
+ */
+static int get_touchpad_device_paths(char (*paths)[256], int max) {
     DIR *dir = opendir("/dev/input");
-    if (!dir) return NULL;
+    if (!dir) return 0;
 
     struct dirent *de;
     char path[256];
+    int n = 0;
 
-    while ((de = readdir(dir)) != NULL) {
+    while (n < max && (de = readdir(dir)) != NULL) {
         if (strncmp(de->d_name, "event", 5) != 0)
             continue;
 
@@ -162,86 +329,69 @@ static char* get_touchpad_device_path(void) {
         close(fd);
 
         if (match) {
-            closedir(dir);
-            /* 呼び出し側が free() すべき */
-            return strdup(path);
+            snprintf(paths[n++], sizeof(paths[0]), "%s", path);
         }
     }
 
     closedir(dir);
-    return NULL;
+    qsort(paths, n, sizeof(paths[0]), cmp_path);
+    return n;
 }
 
-// 角度差分を [-pi, pi] に正規化
-static inline double angle_diff(double a, double b){ 
-    double d = a - b;
-    while (d >  M_PI) d -= 2*M_PI;
-    while (d < -M_PI) d += 2*M_PI;
-    return d;
+/* pad_device_path の "a,b c" を分割する */
+static int parse_device_list(const char *list, char (*paths)[256], int max) {
+    char *copy = strdup(list), *save = NULL;
+    int n = 0;
+    for (char *tok = strtok_r(copy, ", \t", &save); tok && n < max; tok = strtok_r(NULL, ", \t", &save))
+        snprintf(paths[n++], sizeof(paths[0]), "%s", tok);
+    free(copy);
+    return n;
 }
 
-static bool is_in_touch_area(int x, int y, app_t *a){
-    double nx = (double)(x - a->x_min) / (double)(a->x_max - a->x_min) * 2.0 - 1.0;
-    double ny = (double)(y - a->y_min) / (double)(a->y_max - a->y_min) * 2.0 - 1.0;
-    double r = sqrt(nx*nx + ny*ny);
-    return (r >= a->cfg.outer_ratio_min && r <= a->cfg.outer_ratio_max);
-}
-
-static double to_ang(int x, int y, app_t *a){
-    double nx = ((double)x - a->x_min) / (double_t)(a->x_max - a->x_min) * 2.0 - 1.0;
-    double ny = ((double)y - a->y_min) / (double)(a->y_max - a->y_min) *2.0 - 1.0;
-    double ang = atan2(ny, nx);
-    return ang;
-}
-
-static void update_xy_before_scroll(int x, int y, app_t *a){
-    double ang = to_ang(x, y, a);
-    double d = angle_diff(ang, a->last_angle);
-    a->last_angle = a->last_angle + d; // unwrap
-    a->accum_angle += d;
-
-    if (!is_in_touch_area(x, y, a)){
-        if (a->staying_in_area){
-        LOG("Out of area. Scrolling will not begin.");
-        }
-        a->staying_in_area=false;
+/*
+ * エンジンが返した回転量を1つのホイールフレームとして出す。
+ * hires が 0 でなければ REL_WHEEL_HI_RES を出し、ノッチを跨いだフレームだけ REL_WHEEL も付ける
+ * (実機の高解像度ホイールと同じ並び)。
+ */
+static void emit_wheel(app_t *a, int32_t steps, int32_t hires){
+    struct input_event evs[3];
+    int n = 0;
+    memset(evs, 0, sizeof(evs));
+    if (hires != 0) {
+        evs[n].type = EV_REL; evs[n].code = REL_WHEEL_HI_RES;
+        evs[n++].value = hires * a->cfg.wheel_step;
     }
-
-    if (a->staying_in_area && fabs(a->accum_angle)>=a->cfg.start_arc_rad){
-        a->scrolling=true;
-        LOG("Scroll will start.");
+    if (steps != 0) {
+        evs[n].type = EV_REL; evs[n].code = REL_WHEEL;
+        evs[n++].value = steps * a->cfg.wheel_step;
+    }
+    evs[n].type = EV_SYN; evs[n].code = SYN_REPORT; evs[n++].value = 0;
+    // 出力にも入力フレームの時刻を付けておく (uinput では無視される)
+    for (int i = 0; i < n; i++) {
+        evs[i].input_event_sec  = a->frame_us / 1000000;
+        evs[i].input_event_usec = a->frame_us % 1000000;
     }
-}
 
-static void update_xy_while_scroll(int x, int y, app_t *a, struct libevdev_uinput *mouse_uidev){
-    double ang = to_ang(x, y, a);
-    double d = angle_diff(ang, a->last_angle);
-    a->last_angle = a->last_angle + d;
-    a->accum_angle += d;
+    int rc = sink_write(a->mouse_out, evs, n);
+    if (rc < 0) DIE("Failed to write wheel frame: %s", strerror(-rc));
+    stats_latency(a->stats, &a->stats->scroll_ns, a->frame_us);
 
-    while (fabs(a->accum_angle) >= a->cfg.step_rad){
-        int dir = (a->accum_angle > 0) ? -1 : 1;
-        dir *= (a->cfg.invert_scroll) ? -1 : 1;
-        int code = (a->cfg.wheel_hi_res) ? REL_WHEEL_HI_RES : REL_WHEEL;
-        
-        struct input_event ev;
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_REL; ev.code = code; ev.value = dir * a->cfg.wheel_step;
-        if (libevdev_uinput_write_event(mouse_uidev, ev.type, ev.code, ev.value)<0) DIE("Failed to write EV_REL");
-        LOG("write scroll event: ev.type=%hu ev.code=%d ev.value=%d", ev.type, ev.code, ev.value);
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_SYN; ev.code = SYN_REPORT; ev.value = 0;
-        if (libevdev_uinput_write_event(mouse_uidev, ev.type, ev.code, ev.value)<0) DIE("Failed to write SYN");
+    int dir = (hires != 0 ? hires : steps) > 0 ? 1 : -1;
+    if (a->wheel_dir != 0 && dir != a->wheel_dir) stats_add(&a->stats->wheel_reversals, 1);
+    a->wheel_dir = dir;
 
-        a->accum_angle += dir * a->cfg.step_rad;
-    }
+    // 以前は1ステップごとに REL + SYN の2回 write していた
+    stats_add(&a->stats->wheel_frames, 1);
+    if (hires == 0) stats_add(&a->stats->syscalls_saved, 2 * abs(steps) - 1);
+    LOG_DEBUG("write scroll event: hires=%d wheel=%d (steps=%d)",
+              hires * a->cfg.wheel_step, steps * a->cfg.wheel_step, steps);
 }
-    
 
-static void run(){
-    app_t a = {0};
-    a.cfg = (config_t){
-        .pad_device_path = get_touchpad_device_path(),
+static const char *config_path;   // --config (NULL なら /etc/wcircle → カレントの順に探す)
+
+static void load_config(config_t *cfg){
+    *cfg = (config_t){
+        .pad_device_path = NULL,
         .outer_ratio_min = 0.70,
         .outer_ratio_max = 1.415,
         .start_arc_rad   = 5.0*DEG2RAD,
@@ -249,151 +399,1336 @@ static void run(){
         .wheel_step      = 1,
         .wheel_hi_res    = 0,
         .invert_scroll   = 0,
+        .predict_ms      = 0,
+        .kinetic_ms      = 0,
+        .kinetic_min_rad_s = 90.0*DEG2RAD,
+        .kinetic_tick_ms = 16,
+        .filter_min_cutoff = 0,
+        .filter_beta     = 20.0,
+        .reverse_rad     = 0,
+        .multi_touch     = ENGINE_MT_IGNORE,
         .all_wheel       = 0,
+        .log_level       = LOG_LVL_INFO,
+        .pipeline        = 0,
+        .pipeline_ring   = DEFAULT_PIPELINE_RING,
+        .catchup_frames  = DEFAULT_CATCHUP_FRAMES,
+        .rt_mode         = 0,
+        .rt              = { .priority = 50, .cpu = -1, .prefault_kb = 256 },
     };
 
-    if (ini_parse("/etc/wcircle/config.ini", handler, &a.cfg) < 0) {
-        LOG("Can't load '/etc/wcircle/config.ini'");
-        if (ini_parse("config.ini", handler, &a.cfg) < 0) {
-            LOG("Can't load 'config.ini'  from current directory. The default settings will be used.");
+    if (config_path) {
+        if (ini_parse(config_path, handler, cfg) < 0) DIE("Can't load '%s'", config_path);
+    } else if (ini_parse("/etc/wcircle/config.ini", handler, cfg) < 0) {
+        LOG_INFO("Can't load '/etc/wcircle/config.ini'");
+        if (ini_parse("config.ini", handler, cfg) < 0) {
+            LOG_INFO("Can't load 'config.ini'  from current directory. The default settings will be used.");
+        }
+    }
+    log_level = cfg->log_level;
+}
+
+static void init_app(app_t *a, const struct input_absinfo *xi, const struct input_absinfo *yi){
+    a->x_min = xi->minimum; a->x_max = xi->maximum;
+    a->y_min = yi->minimum; a->y_max = yi->maximum;
+    a->curr_x = (a->x_min + a->x_max) / 2;
+    a->curr_y = (a->y_min + a->y_max) / 2;
+    a->frame_flags = 0;
+    a->kinetic_fd = -1;
+
+    engine_config_t ec = {
+        .x_min = a->x_min, .x_max = a->x_max, .y_min = a->y_min, .y_max = a->y_max,
+        .outer_ratio_min = a->cfg.outer_ratio_min,
+        .outer_ratio_max = a->cfg.outer_ratio_max,
+        .start_arc_rad   = a->cfg.start_arc_rad,
+        .step_rad        = a->cfg.step_rad,
+        .all_wheel       = a->cfg.all_wheel,
+        .invert          = a->cfg.invert_scroll,
+        .predict_us      = (int)(a->cfg.predict_ms * 1000),
+        .hi_res          = a->cfg.wheel_hi_res,
+        .kinetic_tau_us  = (int)(a->cfg.kinetic_ms * 1000),
+        .kinetic_min_rad_s = a->cfg.kinetic_min_rad_s,
+        .kinetic_tick_us = a->cfg.kinetic_tick_ms * 1000,
+        .accel_points    = a->cfg.accel_points,
+        .filter_min_cutoff = a->cfg.filter_min_cutoff,
+        .filter_beta     = a->cfg.filter_beta,
+        .reverse_rad     = a->cfg.reverse_rad,
+        .multi_touch     = a->cfg.multi_touch,
+    };
+    memcpy(ec.accel_dps, a->cfg.accel_dps, sizeof(ec.accel_dps));
+    memcpy(ec.accel_gain, a->cfg.accel_gain, sizeof(ec.accel_gain));
+    engine_init(&a->eng, &ec);
+}
+
+// 溜めた passthrough を1回の write で送る
+static void flush_passthrough(app_t *a){
+    if (a->npass == 0) return;
+    int rc = sink_write(a->pad_out, a->pass, a->npass);
+    if (rc<0){
+        DIE("write passthrough frame failed: %s (%zu events)", strerror(-rc), a->npass);
+    }
+    const struct input_event *last = &a->pass[a->npass - 1];
+    stats_latency(a->stats, &a->stats->passthrough_ns,
+                  (int64_t)last->input_event_sec * 1000000 + last->input_event_usec);
+    // pipeline ではジェスチャスレッドと別のカウンタに書く
+    stats_add(&a->stats->pass_frames, 1);
+    stats_add(&a->stats->pass_syscalls_saved, a->npass - 1);
+    a->npass = 0;
+}
+
+/*
+ * 1イベント分の passthrough (読み取りスレッド)。SCROLLING 中に止めるイベントは
+ * ここで落とし、残りを SYN_REPORT まで溜めてフレーム単位で送る。
+ * 送るイベントとその順序はイベント毎に write していたときと同じ。
+ */
+static void passthrough_event(app_t *a, const struct input_event *ev){
+    #define IS_TOUCH_EVENT(ev) \
+        ( ((ev)->type == EV_ABS && (ev)->code == ABS_MT_TRACKING_ID) || \
+          ((ev)->type == EV_KEY && (ev)->code == BTN_TOUCH) )
+
+    if (a->cfg.all_wheel) return;
+    bool suppress = atomic_load_explicit(&a->suppress, memory_order_relaxed);
+    if (!suppress || IS_TOUCH_EVENT(ev)) {
+        a->pass[a->npass++] = *ev;
+    }
+    if ((ev->type == EV_SYN && ev->code == SYN_REPORT) || a->npass == PASS_FRAME_MAX)
+        flush_passthrough(a);
+}
+
+// 累計 *level を n だけ動かし、通過した各値に着いた時刻を reach に残す
+static void move_level(int32_t *level, int32_t n, int64_t (*reach)[STEP_LEVELS], int64_t t){
+    int dir = n > 0 ? 0 : 1;
+    for (int32_t i = 0; i != n; i += (n > 0 ? 1 : -1)) {
+        *level += n > 0 ? 1 : -1;
+        reach[dir][*level & (STEP_LEVELS - 1)] = t;
+    }
+}
+
+/*
+ * 出力したステップのタイミングを、予測しなかった場合 (指が実際に step を跨いだ時刻) と比べる。
+ * 同じ向きに同じ累計値へ着いた時刻の差を step_lead / step_lag に記録する。
+ * 予測しないときは常に 0。先行していた出力が実際の側へ戻ったら行き過ぎの戻しとして数える。
+ */
+static void measure_steps(app_t *a, const engine_result_t *r){
+    int64_t t = a->frame_us;
+    if (r->first_step)
+        hist_record(&a->stats->first_scroll_ns, (uint64_t)(t - a->eng.touch_us) * 1000);
+    if (r->steps == 0 && r->actual_steps == 0) return;
+
+    int32_t out0 = a->out_level, act0 = a->act_level;
+    int32_t ahead = out0 - act0;
+    if (ahead != 0 && (int64_t)r->steps * ahead < 0 && (int64_t)r->actual_steps * r->steps <= 0)
+        stats_add(&a->stats->predict_corrections, abs(r->steps) < abs(ahead) ? abs(r->steps) : abs(ahead));
+
+    move_level(&a->out_level, r->steps, a->out_reach, t);
+    move_level(&a->act_level, r->actual_steps, a->act_reach, t);
+    // 実際に着いた値: 出力が先に着いていれば先行
+    for (int32_t l = act0; l != a->act_level; ) {
+        int dir = a->act_level > act0 ? 0 : 1;
+        l += dir ? -1 : 1;
+        bool ahead = dir ? a->out_level <= l : a->out_level >= l;
+        if (ahead) hist_record(&a->stats->step_lead_ns, (uint64_t)(t - a->out_reach[dir][l & (STEP_LEVELS - 1)]) * 1000);
+    }
+    // 出力が着いた値: 実際がもう着いていれば遅れ (同時なら先行側で 0 を記録済み)。
+    // 実際がこの接触でその値を通っていない (戻しで 0 へ帰る等) ときは前の接触の時刻なので数えない
+    for (int32_t l = out0; l != a->out_level; ) {
+        int dir = a->out_level > out0 ? 0 : 1;
+        l += dir ? -1 : 1;
+        bool behind = dir ? a->act_level <= l : a->act_level >= l;
+        int64_t at = a->act_reach[dir][l & (STEP_LEVELS - 1)];
+        if (behind && at >= a->eng.touch_us && at < t)
+            hist_record(&a->stats->step_lag_ns, (uint64_t)(t - at) * 1000);
+    }
+}
+
+/*
+ * 慣性中だけタイマーを動かす (止まっている間は起床しない)。
+ * 切り替わるときだけ timerfd_settime を呼ぶので、慣性中でないフレームの負担は比較だけ。
+ */
+static void update_kinetic_timer(app_t *a){
+    int64_t due = engine_kinetic_due(&a->eng);
+    if (a->kinetic_fd < 0 || (due != 0) == a->kinetic_armed) return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (due != 0) {
+        int64_t tick = a->eng.kinetic_tick_us;
+        its.it_value.tv_sec = due / 1000000;
+        its.it_value.tv_nsec = due % 1000000 * 1000;
+        its.it_interval.tv_sec = tick / 1000000;
+        its.it_interval.tv_nsec = tick % 1000000 * 1000;
+    }
+    if (timerfd_settime(a->kinetic_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        LOG_WARN("timerfd_settime: %s", strerror(errno));
+    a->kinetic_armed = due != 0;
+}
+
+// 慣性の回転を now_us まで進めて出す。出力の時刻は予定時刻にする (遅延はタイマーの起床遅れ)
+static void kinetic_tick(app_t *a, int64_t now_us){
+    int64_t due = engine_kinetic_due(&a->eng);
+    if (due == 0 || now_us < due) return;
+    engine_result_t r;
+    engine_kinetic_tick(&a->eng, now_us, &r);
+    stats_add(&a->stats->kinetic_ticks, 1);
+    if (r.steps != 0 || r.hires != 0) {
+        int64_t frame_us = a->frame_us;
+        a->frame_us = due;
+        emit_wheel(a, r.steps, r.hires);
+        a->frame_us = frame_us;
+        stats_add(&a->stats->kinetic_frames, 1);
+    }
+    if (engine_kinetic_due(&a->eng) == 0) LOG_DEBUG("kinetic: stopped");
+}
+
+// タイマーを使わないとき (replay) は、入力の時刻 t までのティックを順に処理する
+static void kinetic_until(app_t *a, int64_t t){
+    int64_t due;
+    while ((due = engine_kinetic_due(&a->eng)) != 0 && due <= t) kinetic_tick(a, due);
+}
+
+/*
+ * 1イベント分のデコード (pipeline ではジェスチャスレッド)。SYN_REPORT までの
+ * 位置と BTN_TOUCH の変化を溜め、フレームとしてエンジンに渡してスクロールを出力する。
+ * SYN_DROPPED 後の同期フレームはエンジンが BTN_TOUCH と位置から状態を作り直す。
+ */
+static void gesture_event(app_t *a, const struct input_event *ev){
+    stats_add(&a->stats->events, 1);
+
+    if (ev->type == EV_KEY && ev->code == BTN_TOUCH) {
+        // 同じフレームで触れて離したら後の方だけ残す
+        a->frame_flags &= ~(ENGINE_TOUCH_DOWN | ENGINE_TOUCH_UP);
+        a->frame_flags |= ev->value ? ENGINE_TOUCH_DOWN : ENGINE_TOUCH_UP;
+    }
+    if (ev->type == EV_ABS && ev->code == ABS_X) a->curr_x=ev->value;
+    if (ev->type == EV_ABS && ev->code == ABS_Y) a->curr_y=ev->value;
+    if (a->in_resync && ev->type == EV_ABS && ev->code == ABS_MT_TRACKING_ID && ev->value >= 0)
+        a->frame_flags |= ENGINE_NEW_CONTACT;
+    if (ev->type == EV_ABS && ev->code >= ABS_MT_SLOT) engine_mt_event(&a->eng, ev->code, ev->value);
+
+    if (ev->type == EV_SYN && ev->code == SYN_REPORT && ev->value == 0) {
+        a->frame_us = (int64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+        engine_frame_t f = {
+            .time_us = a->frame_us,
+            .x = a->curr_x,
+            .y = a->curr_y,
+            .flags = a->frame_flags |
+                     (a->in_resync ? ENGINE_RESYNC : 0) |
+                     (a->coalesce ? ENGINE_COALESCE : 0),
+        };
+        engine_result_t r;
+        a->frame_flags = 0;
+        if (f.flags & ENGINE_TOUCH_DOWN) {
+            a->out_level = a->act_level = 0;
+            a->wheel_dir = 0;
+        }
+        if (a->kinetic_fd < 0) kinetic_until(a, a->frame_us);
+        bool kinetic = engine_kinetic_due(&a->eng) != 0;
+        engine_frame(&a->eng, &f, &r);
+        if (!kinetic && engine_kinetic_due(&a->eng) != 0) {
+            stats_add(&a->stats->kinetic_runs, 1);
+            LOG_DEBUG("kinetic: start v=%.1f deg/s", a->eng.kin_v * 1e6 * 360 / GEOM_ANG_TURN);
+        }
+        update_kinetic_timer(a);
+
+        stats_add(&a->stats->frames[r.counted], 1);
+        if (r.coalesced) stats_add(&a->stats->coalesced_frames, 1);
+        if (r.extra_contact) stats_add(&a->stats->mt_extra_frames, 1);
+        if (r.cancelled) {
+            stats_add(&a->stats->mt_cancels, 1);
+            LOG_DEBUG("multi-touch: gesture cancelled");
+        }
+        if (r.steps != 0 || r.hires != 0) emit_wheel(a, r.steps, r.hires);
+        if (r.steps != 0 || r.actual_steps != 0 || r.first_step) measure_steps(a, &r);
+        if (f.flags & ENGINE_RESYNC)
+            LOG_DEBUG("resync: touch=%d state=%s at (%d,%d)", a->eng.touch_down,
+                      state_names[a->eng.state], a->curr_x, a->curr_y);
+        if (a->eng.state != r.counted)
+            LOG_DEBUG("state: %s -> %s", state_names[r.counted], state_names[a->eng.state]);
+    }
+    // 触れた/離した時点で SCROLLING は終わるので、同じフレームの残り (BTN_TOOL_* 等) は流す
+    bool suppress = engine_suppress(&a->eng) &&
+                    !(a->frame_flags & (ENGINE_TOUCH_DOWN | ENGINE_TOUCH_UP));
+    atomic_store_explicit(&a->suppress, suppress, memory_order_relaxed);
+}
+
+/*
+ * pipeline では passthrough だけここで済ませ、フレーム単位でジェスチャスレッドに渡す。
+ * 抑制の判定はジェスチャスレッドが前のフレームまでで決めた状態を見るので、
+ * SCROLLING に入った直後の1フレーム程度は passthrough に流れることがある。
+ * キューが満杯のときは位置だけのフレームを捨てる。捨てたフレームのイベントは SYN_REPORT を外して
+ * 次のフレームの頭に残すので、最後の ABS_X/Y や MT 座標は失われず、角度の差分は次のフレームでまとめて取れる。
+ * 残した分で次のフレームが PIPE_FRAME_MAX を超えたら、分割して空くまで待つ。
+ */
+static void handle_event(app_t *a, const struct input_event *ev){
+    passthrough_event(a, ev);
+    if (!a->pipe) {
+        a->coalesce = a->catchup;
+        a->in_resync = a->resyncing;
+        gesture_event(a, ev);
+        return;
+    }
+
+    pipe_frame_t *f = &a->pending;
+    f->ev[f->n++] = *ev;
+    if ((ev->type == EV_KEY && ev->code == BTN_TOUCH) ||
+        (ev->type == EV_ABS && (ev->code == ABS_MT_SLOT || ev->code == ABS_MT_TRACKING_ID)))
+        a->pending_must = true;
+    bool syn = ev->type == EV_SYN && ev->code == SYN_REPORT;
+    if (syn || f->n == PIPE_FRAME_MAX) {
+        f->coalesce = a->catchup;
+        f->resync = a->resyncing;
+        // 同期フレームは状態の作り直しに要るので捨てない
+        if (pipeline_push(a->pipe, f, a->pending_must || a->resyncing || !syn)) {
+            f->n = 0;
+            a->pending_must = false;
+        } else {
+            f->n--;   // 位置は次のフレームと一緒に渡す
+        }
+    }
+}
+
+// 慣性のタイマーが満了した (pipeline ではジェスチャスレッド)
+static void kinetic_timer(app_t *a){
+    kinetic_tick(a, stats_now_ns() / 1000);
+    update_kinetic_timer(a);
+}
+
+static void gesture_frame(app_t *a, const pipe_frame_t *f){
+    if (f->kinetic) {
+        kinetic_timer(a);
+        return;
+    }
+    a->coalesce = f->coalesce;
+    a->in_resync = f->resync;
+    for (uint32_t i = 0; i < f->n; i++) gesture_event(a, &f->ev[i]);
+}
+
+// 指の位置が動いただけのイベントか (タッチの開始/終了・ボタンを含まない)
+static inline bool is_position_event(const struct input_event *ev){
+    return (ev->type == EV_ABS && ev->code != ABS_MT_TRACKING_ID) ||
+           ev->type == EV_MSC ||
+           (ev->type == EV_SYN && ev->code == SYN_REPORT);
+}
+
+static inline int64_t event_us(const struct input_event *ev){
+    return (int64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+}
+
+/*
+ * まとめて読んだイベントを処理する。溜まっていたフレームが catchup_frames を超えていたら
+ * (負荷で読み取りが遅れた)、位置だけのフレームが続く間は最後以外のフレームの角度計算を省き、
+ * 続きの最後のフレームで差分をまとめて取る。どのフレームをまとめるかはバッチを1回なめて先に決める。
+ * 1つの続きは CATCHUP_MAX_US までで切る (角度の差分が半周を超えると向きを取り違えるため)。
+ * タッチの開始/終了やボタンを含むフレームはそのまま処理するので、出力されるホイールの総量は変わらない。
+ */
+static void process_batch(app_t *a, const struct input_event *evs, size_t n, int nframes){
+    bool behind = a->cfg.catchup_frames > 0 && nframes > a->cfg.catchup_frames;
+    bool merge[DRAIN_BATCH];    // フレーム k の角度計算を次のフレームに任せる
+    int k = 0;
+
+    if (behind) {
+        stats_add(&a->stats->catchup_batches, 1);
+        LOG_DEBUG("behind by %d frames -> catch-up", nframes);
+
+        bool position_only = true, prev_position_only = false;
+        int64_t run_start = 0;
+        for (size_t i = 0; i < n; i++) {
+            const struct input_event *ev = &evs[i];
+            if (!is_position_event(ev)) position_only = false;
+            if (ev->type != EV_SYN || ev->code != SYN_REPORT) continue;
+            int64_t t = event_us(ev);
+            // 1つ前のフレームはこのフレームまで続けてまとめられるか
+            if (k > 0) {
+                merge[k - 1] = prev_position_only && position_only &&
+                               t - run_start <= CATCHUP_MAX_US;
+                if (!merge[k - 1]) run_start = t;
+            } else {
+                run_start = t;
+            }
+            prev_position_only = position_only;
+            position_only = true;
+            k++;
+        }
+        if (k > 0) merge[k - 1] = false;
+        k = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        const struct input_event *ev = &evs[i];
+        bool syn = ev->type == EV_SYN && ev->code == SYN_REPORT;
+        if (behind && syn) a->catchup = merge[k];
+        handle_event(a, ev);
+        if (syn) {
+            a->catchup = false;
+            k++;
+        }
+    }
+}
+
+// イベント供給元 (実デバイス / 録画ファイル)。戻り値は libevdev_next_event() 互換
+typedef int (*next_event_fn)(void *src, unsigned int flags, struct input_event *ev);
+
+/*
+ * SYN_DROPPED の後、同期イベントを -EAGAIN まで全部読んで1フレームとして処理する。
+ * libevdev は落ちた間の差分 (BTN_TOUCH・ABS_X/Y・MT スロット等) を SYN_REPORT で
+ * 閉じて返すので、passthrough にもそのまま流してクローン側の状態も合わせる。
+ */
+static int resync_events(app_t *a, next_event_fn next, void *src){
+    int64_t t0 = stats_now_ns();
+    unsigned long n = 0;
+    int rc;
+    struct input_event ev;
+
+    a->resyncing = true;
+    while ((rc = next(src, LIBEVDEV_READ_FLAG_SYNC, &ev)) == LIBEVDEV_READ_STATUS_SYNC) {
+        handle_event(a, &ev);
+        n++;
+    }
+    a->resyncing = false;
+
+    double us = (stats_now_ns() - t0) / 1e3;
+    stats_add(&a->stats->resyncs, 1);
+    stats_add(&a->stats->resync_events, n);
+    a->stats->resync_us_last = us;
+    if (us > a->stats->resync_us_max) a->stats->resync_us_max = us;
+    LOG_INFO("SYN_DROPPED: resynced with %lu events in %.1f us", n, us);
+    return rc == -EAGAIN ? 0 : rc;
+}
+
+/*
+ * 読めるだけ読んで処理する。読み切ったら 0、それ以外は供給元の戻り値を返す。
+ * 溜まっている量が分かるよう DRAIN_BATCH 個ずつまとめて読んでから処理する。
+ */
+static int drain_events(app_t *a, next_event_fn next, void *src){
+    struct input_event batch[DRAIN_BATCH];
+    while (1){
+        size_t n = 0;
+        int nframes = 0;
+        int event_status = 0;
+        while (n < DRAIN_BATCH) {
+            struct input_event *ev = &batch[n];
+            int rc = next(src, LIBEVDEV_READ_FLAG_NORMAL, ev);
+            if (rc == -EAGAIN) break;
+            if (rc != LIBEVDEV_READ_STATUS_SUCCESS) {
+                event_status = rc;
+                break;
+            }
+            if (ev->type == EV_SYN && ev->code == SYN_REPORT) nframes++;
+            n++;
         }
+        // SYN_DROPPED より前に読めた分は libevdev の状態に反映済みなので先に処理する
+        process_batch(a, batch, n, nframes);
+        if (event_status == LIBEVDEV_READ_STATUS_SYNC) {
+            stats_add(&a->stats->syn_dropped, 1);
+            event_status = resync_events(a, next, src);
+            if (event_status != 0) return event_status;
+            continue;
+        }
+        if (n < DRAIN_BATCH) return event_status;
     }
-    
-    struct libevdev *orig_dev;
-    struct libevdev_uinput *pad_uidev;
+}
+
+typedef struct {
+    struct libevdev *dev;
+    recorder_t rec;        // --record 指定時のみ fp が非 NULL
+} live_src_t;
+
+static void record_event(recorder_t *rec, const struct input_event *ev){
+    int wrc = recorder_write(rec, ev);
+    if (wrc < 0) {
+        LOG_WARN("record write failed: %s -> recording stopped", strerror(-wrc));
+        recorder_close(rec);
+    }
+}
+
+static int live_next_event(void *src, unsigned int flags, struct input_event *ev){
+    live_src_t *s = src;
+    int rc = libevdev_next_event(s->dev, flags, ev);
+    if (rc >= 0 && s->rec.fp) record_event(&s->rec, ev);
+    return rc;
+}
+
+static int replay_src_next_event(void *src, unsigned int flags, struct input_event *ev){
+    return replay_next_event(src, flags, ev);
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig){
+    (void)sig;
+    stop_requested = 1;
+}
+
+// 出力先の指定 (sink_from_spec の書式)
+typedef struct {
+    const char *pad;
+    const char *mouse;
+} sink_specs_t;
+
+// sink_from_spec の失敗を報告して終了する (書式の誤りと開けなかったのを分ける)
+static void die_sink(const char *what, const char *spec){
+    int err = errno;
+    if (err == EINVAL) DIE("Invalid %s sink '%s'", what, spec);
+    DIE("Can't open %s sink '%s': %s", what, spec, strerror(err));
+}
+
+static void print_sink_stats(const char *what, const sink_t *s){
+    fprintf(stderr, "%s sink (%s): events=%lu writes=%lu\n", what, s->ops->name, s->events, s->writes);
+}
+
+// 統計をテキスト化する (ソケット応答 / replay 終了時の表示)
+static size_t format_stats(stats_t *st, unsigned long pad_events, const sink_t *mouse_out,
+                           const pipeline_t *pl, const rt_status_t *rt, int npads, char *buf, size_t len){
+    char extra[1024];
+    int off = snprintf(extra, sizeof(extra),
+                       "pads=%d\n"
+                       "pad_sink_events=%lu\n"
+                       "mouse_sink_events=%lu\n"
+                       "log_dropped=%lu\n",
+                       npads, pad_events, mouse_out->events, log_dropped());
+    if (pl && pl->started)
+        snprintf(extra + off, sizeof(extra) - off,
+                 "pipeline_frames=%lu\n"
+                 "pipeline_depth=%lu\n"
+                 "pipeline_depth_max=%lu\n"
+                 "pipeline_overflow=%lu\n"
+                 "pipeline_stalls=%lu\n",
+                 pl->pushed, pipeline_depth(pl), pl->max_depth, pl->overflow, pl->stalls);
+    off = strlen(extra);
+    rt_format(rt, extra + off, sizeof(extra) - off);
+    return stats_format(st, buf, len, state_names,
+                        sizeof(state_names) / sizeof(state_names[0]), extra);
+}
+
+// 1台分のタッチパッド (入力デバイス・passthrough 先・ジェスチャ状態)
+typedef struct {
+    bool active;                     // 入力を読んでいる
+    bool lost;                       // 切断されたが passthrough クローンは残している
+    char path[256];
+    char name[128];                  // 再接続時の同一性判定用
+    int bustype, vendor, product;
+    int num_slots;                   // ABS_MT_SLOT の数 (無ければ -1)
+    struct timespec lost_at;
+    int fd;
+    live_src_t src;
+    struct libevdev_uinput *uidev;   // passthrough 用クローン
+    bool masked;                     // EVIOCSMASK でジェスチャに要るイベントだけにしている
+    app_t app;
+} pad_t;
+
+typedef struct {
+    config_t cfg;
+    const sink_specs_t *specs;
+    const char *record_path;
+    char paths[MAX_PADS][256];       // 設定で指定されたデバイス (npaths == 0 なら自動検出)
+    int npaths;
+    pad_t pads[MAX_PADS];
+    int npads;                       // active な数
+    bool have_sysfs;                 // /sys/class/input で判定できるか
+    int epfd;
+    int statsfd;
+    int hotplugfd;
     struct libevdev_uinput *mouse_uidev;
-    
-    int infd = open(a.cfg.pad_device_path, O_RDONLY | O_NONBLOCK);
-    if (infd < 0) DIE("open input: %s", strerror(errno));
+    sink_t *mouse_out;
+    pipeline_t pipe;                 // cfg.pipeline のときのジェスチャスレッド
+    rt_status_t rt;
+    stats_t stats;
+} daemon_t;
+
+static double ms_since(const struct timespec *t0){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - t0->tv_sec) * 1e3 + (now.tv_nsec - t0->tv_nsec) * 1e-6;
+}
+
+// 2台目以降の出力/録画ファイルは "PATH.<idx>" にする
+static void indexed_path(char *out, size_t len, const char *path, int idx){
+    if (idx == 0) snprintf(out, len, "%s", path);
+    else snprintf(out, len, "%s.%d", path, idx);
+}
+
+static bool same_identity(const pad_t *p, struct libevdev *dev){
+    return p->bustype == libevdev_get_id_bustype(dev) &&
+           p->vendor  == libevdev_get_id_vendor(dev) &&
+           p->product == libevdev_get_id_product(dev) &&
+           strcmp(p->name, libevdev_get_name(dev)) == 0;
+}
+
+// passthrough 先 (クローン・sink) を破棄する
+static void release_pad_output(pad_t *p){
+    sink_close(p->app.pad_out);
+    p->app.pad_out = NULL;
+    if (p->uidev) libevdev_uinput_destroy(p->uidev);
+    p->uidev = NULL;
+    recorder_close(&p->src.rec);
+    p->lost = false;
+}
+
+// デバイスを開く。autodetect ならタッチパッド以外は -ENODEV
+static int probe_device(const char *path, bool autodetect, int *fd_out, struct libevdev **dev_out){
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return -errno;
+
+    struct libevdev *dev = NULL;
+    int rc = libevdev_new_from_fd(fd, &dev);
+    if (rc < 0) {
+        close(fd);
+        return rc;
+    }
+    if (autodetect && !is_touchpad(dev)) {
+        libevdev_free(dev);
+        close(fd);
+        return -ENODEV;
+    }
+    *fd_out = fd;
+    *dev_out = dev;
+    return 0;
+}
+
+static int set_mask(int fd, unsigned int type, const uint8_t *bits, size_t size){
+    struct input_mask m = { .type = type, .codes_size = size, .codes_ptr = (uintptr_t)bits };
+    return ioctl(fd, EVIOCSMASK, &m) < 0 ? -errno : 0;
+}
+
+/*
+ * gesture_only なら EV_SYN と BTN_TOUCH・ABS_X・ABS_Y (mt なら MT のスロット・ID・位置も)
+ * 以外をカーネル側で落とす (圧力・BTN_TOOL_*・MSC_TIMESTAMP 等)。中身が無くなったフレームは
+ * SYN_REPORT ごと届かなくなるので起床も減る。false ですべて届く状態に戻す。
+ * マスクは fd (evdev クライアント) 毎なので passthrough クローン等には影響しない。
+ */
+static int set_event_mask(int fd, bool gesture_only, bool mt){
+    uint8_t types[(EV_CNT + 7) / 8], keys[(KEY_CNT + 7) / 8], abs[(ABS_CNT + 7) / 8];
+    int fill = gesture_only ? 0x00 : 0xff;
+    memset(types, fill, sizeof(types));
+    memset(keys, fill, sizeof(keys));
+    memset(abs, fill, sizeof(abs));
+    if (gesture_only) {
+        #define SET_BIT(b, n) ((b)[(n) / 8] |= 1u << ((n) % 8))
+        SET_BIT(types, EV_SYN);
+        SET_BIT(types, EV_KEY);
+        SET_BIT(types, EV_ABS);
+        SET_BIT(keys, BTN_TOUCH);
+        SET_BIT(abs, ABS_X);
+        SET_BIT(abs, ABS_Y);
+        if (mt) {
+            SET_BIT(abs, ABS_MT_SLOT);
+            SET_BIT(abs, ABS_MT_TRACKING_ID);
+            SET_BIT(abs, ABS_MT_POSITION_X);
+            SET_BIT(abs, ABS_MT_POSITION_Y);
+        }
+        #undef SET_BIT
+    }
+    int rc;
+    if ((rc = set_mask(fd, EV_KEY, keys, sizeof(keys))) < 0) return rc;
+    if ((rc = set_mask(fd, EV_ABS, abs, sizeof(abs))) < 0) return rc;
+    return set_mask(fd, 0, types, sizeof(types));
+}
+
+/*
+ * passthrough しないモード (all_wheel) ならマスクを掛け、そうでなければ外す。
+ * --record 中は録画を実機どおりに残すため掛けない。
+ * multi_touch=off でマスクしている間は libevdev が MT の状態を追えないので、SYN_DROPPED 後の
+ * 同期では接触し直したように見えることがある (all_wheel では基準角を取り直すだけ)。
+ */
+static void update_event_mask(const daemon_t *d, pad_t *p){
+    bool want = p->active && d->cfg.all_wheel && !d->record_path;
+    if (want == p->masked) return;
+    bool mt = p->app.cfg.multi_touch != ENGINE_MT_OFF;
+    int rc = set_event_mask(p->fd, want, mt);
+    if (!want) {
+        // 切断後は失敗するが、その fd を閉じればマスクも消える
+        p->masked = false;
+        LOG_DEBUG("%s: event mask cleared (rc=%d)", p->path, rc);
+        return;
+    }
+    if (rc < 0) {
+        LOG_WARN("EVIOCSMASK on %s failed: %s; all events stay delivered", p->path, strerror(-rc));
+        set_event_mask(p->fd, false, false);
+        return;
+    }
+    p->masked = true;
+    LOG_INFO("%s: event mask set (BTN_TOUCH, ABS_X, ABS_Y%s only)", p->path, mt ? ", MT slots" : "");
+}
+
+/*
+ * 開いたデバイスを grab し、passthrough 先を用意してスロット idx に載せる。
+ * 失敗は -errno (fd/dev は呼び出し側が閉じる)。
+ * 同じデバイスが戻ってきた (p->lost で同一性が一致) ときはクローンを使い回す。
+ */
+static int open_pad(daemon_t *d, int idx, const char *path, int fd, struct libevdev *dev){
+    pad_t *p = &d->pads[idx];
+    const sink_specs_t *specs = d->specs;
 
-    if (libevdev_new_from_fd(infd, &orig_dev) < 0) DIE("libevdev_new_from_fd");
-    fprintf(stderr, "Input device name: \"%s\"\n", libevdev_get_name(orig_dev));
-    fprintf(stderr, "Input device ID: bus %#x vendor %#x product %#x\n",
-            libevdev_get_id_bustype(orig_dev),
-            libevdev_get_id_vendor(orig_dev),
-            libevdev_get_id_product(orig_dev));
+    // ジェスチャスレッドがこのスロットの古いフレームを処理し終えるまで待つ
+    pipeline_quiesce(&d->pipe);
+
+    if (!libevdev_has_event_code(dev, EV_ABS, ABS_X) ||
+        !libevdev_has_event_code(dev, EV_ABS, ABS_Y)) {
+        LOG_WARN("%s has no ABS_X/ABS_Y (need a touchpad-like device)", path);
+        return -ENOTSUP;
+    }
+    LOG_INFO("Input device %s: \"%s\" bus %#x vendor %#x product %#x", path,
+             libevdev_get_name(dev),
+             libevdev_get_id_bustype(dev),
+             libevdev_get_id_vendor(dev),
+             libevdev_get_id_product(dev));
 
-    if (!libevdev_has_event_code(orig_dev, EV_ABS, ABS_X) ||
-        !libevdev_has_event_code(orig_dev, EV_ABS, ABS_Y)) {
-        DIE("This device has no ABS_X/ABS_Y (need a touchpad-like device)");
+    // ev.time を CLOCK_MONOTONIC にして遅延を測る。慣性のタイマーもこの時刻で進める
+    bool monotonic = libevdev_set_clock_id(dev, CLOCK_MONOTONIC) == 0;
+    if (!monotonic) {
+        LOG_WARN("Can't switch evdev clock of %s to CLOCK_MONOTONIC; latency is not measured%s.", path,
+                 d->cfg.kinetic_ms > 0 ? " and momentum scrolling is disabled" : "");
+        atomic_store_explicit(&d->stats.latency_enabled, false, memory_order_relaxed);
     }
 
     // 最初から元デバイスをgrab
-    int rc = libevdev_grab(orig_dev, LIBEVDEV_GRAB);
-    if (rc < 0) DIE("Failed to grab device.");
-
-    rc = libevdev_uinput_create_from_device(orig_dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &pad_uidev);
-    if (rc < 0) DIE("Failed to create uinput touchpad device.");
-
-    mouse_uidev = create_virtual_mouse();
-    if (!mouse_uidev) DIE("Failed to create uinput mouse device.");
-
-    const struct input_absinfo *xi = libevdev_get_abs_info(orig_dev, ABS_X);
-    const struct input_absinfo *yi = libevdev_get_abs_info(orig_dev, ABS_Y);
-    a.x_min = xi->minimum; a.x_max = xi->maximum;
-    a.y_min = yi->minimum; a.y_max = yi->maximum;
-
-    double cx = (a.x_min + a.x_max) * 0.5, cy = (a.y_min + a.y_max) * 0.5;
-    LOG("ready. device=%s center=(%.1f,%.1f)", a.cfg.pad_device_path, cx, cy);
-
-    int curr_x = (int)cx, curr_y = (int)cy;
-    bool is_x_updated=false, is_y_updated=false;
-    int event_type=0, event_code=0, event_value=0;
-
-    typedef enum {
-        NONE,                //0
-        FIRST,               //1
-        STARTED_IN_AREA,     //2
-        STARTED_NOT_IN_AREA, //3
-        SCROLLING,           //4
-        END                  //5
-    } event_state;
-    event_state state=NONE; 
-    
+    int rc = libevdev_grab(dev, LIBEVDEV_GRAB);
+    if (rc < 0) {
+        LOG_WARN("Failed to grab %s.", path);
+        return rc;
+    }
+
+    if (p->lost && !same_identity(p, dev)) release_pad_output(p);
+    bool reuse = p->lost;
+
+    if (!reuse && strcmp(specs->pad, "uinput") == 0) {
+        rc = libevdev_uinput_create_from_device(dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &p->uidev);
+        if (rc < 0) {
+            LOG_WARN("Failed to create uinput touchpad device for %s.", path);
+            p->uidev = NULL;
+            libevdev_grab(dev, LIBEVDEV_UNGRAB);
+            return rc;
+        }
+    }
+
+    const struct input_absinfo *xi = libevdev_get_abs_info(dev, ABS_X);
+    const struct input_absinfo *yi = libevdev_get_abs_info(dev, ABS_Y);
+    sink_t *pad_out = p->app.pad_out;
+    memset(&p->app, 0, sizeof(p->app));
+    p->app.cfg = d->cfg;
+    // 時刻が CLOCK_REALTIME のままだと timerfd (CLOCK_MONOTONIC) と比べられない
+    if (!monotonic) p->app.cfg.kinetic_ms = 0;
+    // MT の座標を ABS_X/ABS_Y の範囲で扱うので、範囲が違うデバイスでは MT を見ない
+    const struct input_absinfo *mxi = libevdev_get_abs_info(dev, ABS_MT_POSITION_X);
+    const struct input_absinfo *myi = libevdev_get_abs_info(dev, ABS_MT_POSITION_Y);
+    if (p->app.cfg.multi_touch != ENGINE_MT_OFF &&
+        (!mxi || !myi || mxi->minimum != xi->minimum || mxi->maximum != xi->maximum ||
+         myi->minimum != yi->minimum || myi->maximum != yi->maximum)) {
+        LOG_INFO("%s: MT axes differ from ABS_X/ABS_Y; tracking the legacy position only.", path);
+        p->app.cfg.multi_touch = ENGINE_MT_OFF;
+    }
+    init_app(&p->app, xi, yi);
+    p->app.stats = &d->stats;
+    p->app.mouse_out = d->mouse_out;
+    if (d->pipe.started) {
+        p->app.pipe = &d->pipe;
+        p->app.pending.pad = idx;
+    }
+    if (p->app.eng.kinetic_tau_us) {
+        p->app.kinetic_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        struct epoll_event epev = { .events = EPOLLIN, .data.u64 = EP_KINETIC + idx };
+        if (p->app.kinetic_fd < 0 || epoll_ctl(d->epfd, EPOLL_CTL_ADD, p->app.kinetic_fd, &epev) < 0)
+            DIE("kinetic timer: %s", strerror(errno));
+    }
+
+    if (reuse) {
+        p->app.pad_out = pad_out;
+    } else {
+        char spec[300];
+        if (strncmp(specs->pad, "file:", 5) == 0) {
+            char file[280];
+            indexed_path(file, sizeof(file), specs->pad + 5, idx);
+            snprintf(spec, sizeof(spec), "file:%s", file);
+        } else {
+            snprintf(spec, sizeof(spec), "%s", specs->pad);
+        }
+        p->app.pad_out = sink_from_spec(spec, p->uidev, xi, yi);
+        if (!p->app.pad_out) die_sink("pad", spec);
+    }
+
+    if (d->record_path && !p->src.rec.fp) {
+        char file[280];
+        indexed_path(file, sizeof(file), d->record_path, idx);
+        rc = recorder_open(&p->src.rec, file, xi, yi);
+        if (rc < 0) DIE("open record file '%s': %s", file, strerror(-rc));
+        LOG_INFO("recording %s to %s", path, file);
+    }
+
+    snprintf(p->path, sizeof(p->path), "%s", path);
+    snprintf(p->name, sizeof(p->name), "%s", libevdev_get_name(dev));
+    p->bustype = libevdev_get_id_bustype(dev);
+    p->vendor  = libevdev_get_id_vendor(dev);
+    p->product = libevdev_get_id_product(dev);
+    p->num_slots = libevdev_get_num_slots(dev);
+    p->fd = fd;
+    p->src.dev = dev;
+    p->active = true;
+    p->lost = false;
+    update_event_mask(d, p);
+    LOG_INFO("ready. device=%s center=(%d,%d)", path, p->app.curr_x, p->app.curr_y);
+    return 0;
+}
+
+// 切断時にクローン側で押しっぱなしにならないよう、接触をすべて離した状態を送る
+static void release_touch(pad_t *p){
+    struct input_event evs[2 * 16 + 4];
+    size_t n = 0;
+    memset(evs, 0, sizeof(evs));
+    #define PUSH(t, c, v) do { evs[n].type = (t); evs[n].code = (c); evs[n].value = (v); n++; } while (0)
+    for (int slot = 0; slot < p->num_slots && slot < 16; slot++) {
+        PUSH(EV_ABS, ABS_MT_SLOT, slot);
+        PUSH(EV_ABS, ABS_MT_TRACKING_ID, -1);
+    }
+    PUSH(EV_KEY, BTN_TOUCH, 0);
+    PUSH(EV_KEY, BTN_TOOL_FINGER, 0);
+    PUSH(EV_SYN, SYN_REPORT, 0);
+    #undef PUSH
+    if (sink_write(p->app.pad_out, evs, n) < 0) LOG_WARN("Failed to release touches on %s clone.", p->path);
+}
+
+// 入力側だけ閉じる。keep_output なら passthrough クローンを残して再接続を待つ
+static void close_pad(daemon_t *d, pad_t *p, bool keep_output){
+    if (p->active) {
+        epoll_ctl(d->epfd, EPOLL_CTL_DEL, p->fd, NULL);
+        p->active = false;
+        if (p->app.kinetic_fd >= 0) {
+            // ジェスチャスレッドがタイマーに触らなくなってから閉じる
+            pipeline_quiesce(&d->pipe);
+            close(p->app.kinetic_fd);
+            p->app.kinetic_fd = -1;
+            p->app.kinetic_armed = false;
+        }
+        update_event_mask(d, p);
+        libevdev_grab(p->src.dev, LIBEVDEV_UNGRAB);
+        libevdev_free(p->src.dev);
+        p->src.dev = NULL;
+        close(p->fd);
+        d->npads--;
+    }
+    if (keep_output) {
+        if (!p->app.cfg.all_wheel) release_touch(p);
+        p->lost = true;
+        clock_gettime(CLOCK_MONOTONIC, &p->lost_at);
+    } else if (p->app.pad_out || p->lost) {
+        release_pad_output(p);
+    }
+}
+
+// 自分が作った passthrough クローンか
+static bool is_own_clone(const daemon_t *d, const char *path){
+    for (int i = 0; i < MAX_PADS; i++) {
+        const char *node = d->pads[i].uidev ? libevdev_uinput_get_devnode(d->pads[i].uidev) : NULL;
+        if (node && strcmp(node, path) == 0) return true;
+    }
+    return false;
+}
+
+/*
+ * path のデバイスを取り付ける。設定で指定されていればその番号のスロット、
+ * 自動検出なら 同一デバイスの切断スロット > 未使用 > 他の切断スロット の順に選ぶ。
+ */
+static void attach_pad(daemon_t *d, const char *path){
+    bool autodetect = d->npaths == 0;
+    int slot = -1;
+
+    for (int i = 0; i < MAX_PADS; i++)
+        if (d->pads[i].active && strcmp(d->pads[i].path, path) == 0) return;
+    if (is_own_clone(d, path)) return;
+    // タッチパッド以外はデバイスノードを開かずに弾く
+    if (autodetect && d->have_sysfs && !discover_is_touchpad(path)) return;
+    if (!autodetect) {
+        for (int i = 0; i < d->npaths; i++)
+            if (strcmp(d->paths[i], path) == 0) slot = i;
+        if (slot < 0) return;
+    }
+
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int fd = -1;
+    struct libevdev *dev = NULL;
+    int rc = probe_device(path, autodetect, &fd, &dev);
+    if (rc < 0) {
+        // 抜かれた直後やタッチパッド以外は黙って無視する
+        if (rc != -ENODEV && rc != -ENOENT) LOG_WARN("Skipping %s: %s", path, strerror(-rc));
+        return;
+    }
+
+    if (autodetect) {
+        for (int i = 0; i < MAX_PADS && slot < 0; i++)
+            if (d->pads[i].lost && same_identity(&d->pads[i], dev)) slot = i;
+        for (int i = 0; i < MAX_PADS && slot < 0; i++)
+            if (!d->pads[i].active && !d->pads[i].lost) slot = i;
+        for (int i = 0; i < MAX_PADS && slot < 0; i++)
+            if (!d->pads[i].active) slot = i;
+    }
+    if (slot < 0 || d->pads[slot].active) {
+        libevdev_free(dev);
+        close(fd);
+        return;
+    }
+
+    pad_t *p = &d->pads[slot];
+    bool reconnect = p->lost && same_identity(p, dev);
+    rc = open_pad(d, slot, path, fd, dev);
+    if (rc < 0) {
+        LOG_WARN("Skipping %s: %s", path, strerror(-rc));
+        libevdev_free(dev);
+        close(fd);
+        return;
+    }
+    struct epoll_event epev = { .events = EPOLLIN, .data.u64 = slot };
+    if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, p->fd, &epev) < 0) DIE("epoll_ctl: %s", strerror(errno));
+    d->npads++;
+
+    if (reconnect) {
+        double attach_ms = ms_since(&t0);
+        double gap_ms = ms_since(&p->lost_at);
+        stats_add(&d->stats.reconnects, 1);
+        d->stats.reconnect_gap_ms_last = gap_ms;
+        d->stats.reconnect_attach_ms_last = attach_ms;
+        if (gap_ms > d->stats.reconnect_gap_ms_max) d->stats.reconnect_gap_ms_max = gap_ms;
+        LOG_INFO("reconnected %s after %.1f ms (attach took %.2f ms)", path, gap_ms, attach_ms);
+    }
+}
+
+// /dev/input の inotify イベントを処理する
+static void handle_hotplug(daemon_t *d){
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(d->hotplugfd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event *ie = (const struct inotify_event *)ptr;
+            ptr += sizeof(*ie) + ie->len;
+            if (ie->len == 0 || strncmp(ie->name, "event", 5) != 0) continue;
+
+            char path[256];
+            snprintf(path, sizeof(path), "/dev/input/%s", ie->name);
+            attach_pad(d, path);
+        }
+    }
+}
+
+static bool same_pads(const pad_info_t *a, int na, const pad_info_t *b, int nb){
+    if (na != nb) return false;
+    for (int i = 0; i < na; i++) {
+        if (strcmp(a[i].path, b[i].path) != 0 || strcmp(a[i].name, b[i].name) != 0 ||
+            a[i].bustype != b[i].bustype || a[i].vendor != b[i].vendor || a[i].product != b[i].product)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * 自動検出。キャッシュのデバイスが今も同じものを指していれば先にその順で開く。
+ * 止まっている間に増えたタッチパッドもあるので、sysfs (読めなければ全ノードを開く
+ * 従来の方法) は毎回見て、まだ開いていないものを足す。
+ */
+static void discover_and_attach(daemon_t *d){
+    const char *cache = d->cfg.device_cache ? d->cfg.device_cache : DEFAULT_DEVICE_CACHE;
+    pad_info_t cached[MAX_PADS], found[MAX_PADS];
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int ncached = cache[0] ? devcache_load(cache, cached, MAX_PADS) : 0;
+    bool hit = ncached > 0;
+    for (int i = 0; i < ncached && hit; i++)
+        if (!devcache_valid(&cached[i])) hit = false;
+    if (hit) {
+        for (int i = 0; i < ncached; i++) attach_pad(d, cached[i].path);
+        hit = d->npads == ncached;
+    }
+
+    // 開いているものは attach_pad が飛ばす
+    int n = d->have_sysfs ? discover_touchpads(found, MAX_PADS) : -ENOENT;
+    if (n >= 0) {
+        for (int i = 0; i < n; i++) attach_pad(d, found[i].path);
+    } else {
+        char paths[MAX_PADS][256];
+        n = get_touchpad_device_paths(paths, MAX_PADS);
+        for (int i = 0; i < n; i++) attach_pad(d, paths[i]);
+    }
+    if (d->npads != ncached) hit = false;
+    LOG_INFO("discovery: %d touchpad(s) in %.2f ms (%s)", d->npads, ms_since(&t0),
+             hit ? "cache" : "scan");
+
+    if (!cache[0]) return;
+    n = 0;
+    for (int i = 0; i < MAX_PADS; i++) {
+        const pad_t *p = &d->pads[i];
+        if (!p->active) continue;
+        pad_info_t *info = &found[n++];
+        memset(info, 0, sizeof(*info));
+        snprintf(info->path, sizeof(info->path), "%s", p->path);
+        snprintf(info->name, sizeof(info->name), "%s", p->name);
+        info->bustype = p->bustype;
+        info->vendor = p->vendor;
+        info->product = p->product;
+    }
+    if (n > 0 && !same_pads(cached, ncached, found, n)) {
+        int rc = devcache_save(cache, found, n);
+        if (rc < 0) LOG_WARN("Can't write device cache '%s': %s", cache, strerror(-rc));
+    }
+}
+
+static void daemon_gesture_frame(void *ctx, const pipe_frame_t *f){
+    daemon_t *d = ctx;
+    gesture_frame(&d->pads[f->pad].app, f);
+}
+
+static void run(const char *record_path, const sink_specs_t *specs){
+    static daemon_t d;
+
+    memset(&d, 0, sizeof(d));
+    d.specs = specs;
+    d.record_path = record_path;
+    d.statsfd = d.hotplugfd = -1;
+    d.rt.cpu = -1;
+    d.have_sysfs = access("/sys/class/input", R_OK) == 0;
+    load_config(&d.cfg);
+    if (d.cfg.pad_device_path)
+        d.npaths = parse_device_list(d.cfg.pad_device_path, d.paths, MAX_PADS);
+
+    stats_init(&d.stats, true);
+
+    // 仮想スクロールマウスは1つだけ作り、全タッチパッド・再接続をまたいで使い続ける
+    if (strcmp(specs->mouse, "uinput") == 0) {
+        d.mouse_uidev = create_virtual_mouse();
+        if (!d.mouse_uidev) DIE("Failed to create uinput mouse device.");
+    }
+    d.mouse_out = sink_from_spec(specs->mouse, d.mouse_uidev, NULL, NULL);
+    if (!d.mouse_out) die_sink("mouse", specs->mouse);
+
+    if (d.cfg.pipeline) {
+        int rc = pipeline_start(&d.pipe, d.cfg.pipeline_ring, false, daemon_gesture_frame, &d);
+        if (rc < 0) DIE("Failed to start gesture thread: %s", strerror(-rc));
+        LOG_INFO("pipelined mode: gesture thread started (ring=%lu)", d.pipe.mask + 1);
+    }
+
+    // 入力が来るまで epoll で待つ
+    d.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (d.epfd < 0) DIE("epoll_create1: %s", strerror(errno));
+
+    // 列挙より先に監視を始めて、その間に挿されたデバイスを取りこぼさない
+    d.hotplugfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (d.hotplugfd >= 0 && inotify_add_watch(d.hotplugfd, "/dev/input", IN_CREATE | IN_ATTRIB) < 0) {
+        close(d.hotplugfd);
+        d.hotplugfd = -1;
+    }
+    if (d.hotplugfd < 0) {
+        LOG_WARN("Can't watch /dev/input: %s; hotplug is disabled.", strerror(errno));
+    } else {
+        struct epoll_event epev = { .events = EPOLLIN, .data.u64 = EP_HOTPLUG };
+        if (epoll_ctl(d.epfd, EPOLL_CTL_ADD, d.hotplugfd, &epev) < 0) DIE("epoll_ctl: %s", strerror(errno));
+    }
+
+    if (d.npaths > 0) {
+        for (int i = 0; i < d.npaths; i++) attach_pad(&d, d.paths[i]);
+    } else {
+        discover_and_attach(&d);
+    }
+    if (d.npads == 0) {
+        if (d.hotplugfd < 0) DIE("No usable touchpad device.");
+        LOG_WARN("No touchpad yet; waiting for one to appear.");
+    }
+
+    const char *sock_path = d.cfg.stats_socket ? d.cfg.stats_socket : DEFAULT_STATS_SOCKET;
+    if (sock_path[0]) {
+        d.statsfd = stats_server_open(sock_path);
+        if (d.statsfd < 0) {
+            LOG_WARN("Can't open stats socket '%s': %s", sock_path, strerror(-d.statsfd));
+        } else {
+            struct epoll_event epev = { .events = EPOLLIN, .data.u64 = EP_STATS };
+            if (epoll_ctl(d.epfd, EPOLL_CTL_ADD, d.statsfd, &epev) < 0) DIE("epoll_ctl: %s", strerror(errno));
+            LOG_INFO("stats available on %s", sock_path);
+        }
+    }
+
+    // SIGINT/SIGTERM で epoll_wait を抜けて後始末する (録画ファイルを閉じるため)
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // 初期化 (デバイス・バッファの確保) が済んでから固定する
+    if (d.cfg.rt_mode) {
+        rt_apply(&d.cfg.rt, &d.rt);
+        if (d.pipe.started) rt_apply_thread(d.pipe.thread, d.rt.priority - 1, &d.rt);
+    }
+
     // Event check loop
-    while (1){
-        struct input_event ev;
-        int event_status = libevdev_next_event(orig_dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-        if (event_status == LIBEVDEV_READ_STATUS_SUCCESS) {
-            if (ev.type == EV_SYN && ev.code == SYN_DROPPED){
-                event_status = libevdev_next_event(orig_dev, LIBEVDEV_READ_FLAG_SYNC, &ev);
+    while (!stop_requested){
+        struct epoll_event ready[MAX_EPOLL_EVENTS];
+        int nready = epoll_wait(d.epfd, ready, MAX_EPOLL_EVENTS, -1);
+        if (nready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait: %s -> exit", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < nready; i++){
+            uint64_t token = ready[i].data.u64;
+            if (token == EP_STATS) {
+                char buf[STATS_TEXT_MAX];
+                unsigned long pad_events = 0;
+                for (int k = 0; k < MAX_PADS; k++)
+                    if (d.pads[k].app.pad_out) pad_events += d.pads[k].app.pad_out->events;
+                size_t len = format_stats(&d.stats, pad_events, d.mouse_out, &d.pipe, &d.rt,
+                                          d.npads, buf, sizeof(buf));
+                stats_server_serve(d.statsfd, buf, len);
+                continue;
             }
-            
-            event_type=ev.type; event_code=ev.code; event_value=ev.value;
-            
-            // passthrough
-            #define IS_TOUCH_EVENT(ev) \
-                ( ((ev).type == EV_ABS && (ev).code == ABS_MT_TRACKING_ID) || \
-                  ((ev).type == EV_KEY && (ev).code == BTN_TOUCH) )
-
-            if (!a.cfg.all_wheel && (state!=SCROLLING || IS_TOUCH_EVENT(ev))) {
-                int rc = libevdev_uinput_write_event(pad_uidev, ev.type, ev.code, ev.value);
-                if (rc<0){
-                    DIE("write_event failed: %s\nev.type=%hu ev.code=%d ev.value=%d", strerror(-rc), ev.type, ev.code, ev.value);
-                }
+            if (token == EP_HOTPLUG) {
+                handle_hotplug(&d);
+                continue;
             }
-            
-            if (event_type == EV_KEY && event_code == BTN_TOUCH && event_value == 1) state=FIRST;
-            if (event_type == EV_KEY && event_code == BTN_TOUCH && event_value == 0) state=END;
-            if (event_type == EV_ABS && event_code == ABS_X) curr_x=event_value;
-            if (event_type == EV_ABS && event_code == ABS_Y) curr_y=event_value;
-
-            if (event_type == EV_SYN && event_code == SYN_REPORT && event_value == 0) {
-                switch (state) {
-                case FIRST:
-                    if ((a.cfg.all_wheel) || (is_in_touch_area(curr_x, curr_y, &a))){
-                        state= a.cfg.all_wheel ? SCROLLING : STARTED_IN_AREA;
-                        a.staying_in_area = true;
-                        a.scrolling = false;
-                        a.accum_angle = 0.0;
-                        a.last_angle = to_ang(curr_x, curr_y, &a);
-                        LOG("First touch detected, begin touch");
-                    } else {
-                        state=STARTED_NOT_IN_AREA;
-                        LOG("First touch detected, but this is not in area.");
-                    }
-                    break;
-                case STARTED_IN_AREA:
-                    // 外周部で閾値以上回転したらスクロールスタート
-                    update_xy_before_scroll(curr_x, curr_y, &a);
-                    if (a.scrolling) {
-                        state=SCROLLING;
-                    }
-                    break;
-                case SCROLLING:
-                    update_xy_while_scroll(curr_x, curr_y, &a, mouse_uidev);
-                    break;
-                case END:
-                    state=FIRST;
-                    LOG("End touch.");
-                    break;
-                default:
-                    break;
+            if (token >= EP_KINETIC) {
+                app_t *a = &d.pads[token - EP_KINETIC].app;
+                uint64_t expirations;
+                if (a->kinetic_fd < 0 || read(a->kinetic_fd, &expirations, sizeof(expirations)) < 0) continue;
+                if (d.pipe.started) {
+                    static pipe_frame_t tick = { .kinetic = true };
+                    tick.pad = token - EP_KINETIC;
+                    pipeline_push(&d.pipe, &tick, true);
+                } else {
+                    kinetic_timer(a);
                 }
+                continue;
             }
+            if (token >= MAX_PADS || !d.pads[token].active) continue;
 
-            
-        } else if (event_status == -EAGAIN){
-            // 少し待つ
-            usleep(1000);
-        } else {
-            // デバイス切断など
-            LOG("libevdev rc=%d -> exit", event_status);
-            break;
+            // 起床1回で溜まっているイベントを全て読み切る
+            pad_t *p = &d.pads[token];
+            int event_status = drain_events(&p->app, live_next_event, &p->src);
+            if (event_status != 0) {
+                // デバイス切断やサスペンド復帰など。クローンとマウスは残して再接続を待つ
+                char path[256];
+                snprintf(path, sizeof(path), "%s", p->path);
+                LOG_WARN("libevdev rc=%d on %s -> detach", event_status, path);
+                close_pad(&d, p, true);
+                // ノードが残っていればその場で付け直す (消えていれば inotify を待つ)
+                attach_pad(&d, path);
+            }
         }
     }
-    if (a.cfg.pad_device_path) free((void*)a.cfg.pad_device_path);
-    libevdev_uinput_destroy(pad_uidev);
-    libevdev_uinput_destroy(mouse_uidev);
-    libevdev_grab(orig_dev, LIBEVDEV_UNGRAB);
-    libevdev_free(orig_dev);
+    pipeline_stop(&d.pipe);
+    close(d.epfd);
+    if (d.hotplugfd >= 0) close(d.hotplugfd);
+    if (d.statsfd >= 0) {
+        close(d.statsfd);
+        unlink(sock_path);
+    }
+    for (int i = 0; i < MAX_PADS; i++) close_pad(&d, &d.pads[i], false);
+    sink_close(d.mouse_out);
+    if (d.mouse_uidev) libevdev_uinput_destroy(d.mouse_uidev);
+    free(d.cfg.pad_device_path);
+    free(d.cfg.stats_socket);
+    free(d.cfg.device_cache);
+}
+
+static void replay_gesture_frame(void *ctx, const pipe_frame_t *f){
+    gesture_frame(ctx, f);
+}
+
+// --replay / --synth 共通: src の列をデバイス無しで同じ状態遷移に流し、結果を表示する。
+// /dev/input は開かない。マウス出力だけは uinput も選べる (書き込みの負荷を測るため)
+static void run_offline(app_t *a, const char *what, next_event_fn next, void *src,
+                        const struct input_absinfo *xi, const struct input_absinfo *yi,
+                        bool realtime, const sink_specs_t *specs, const unsigned long *events){
+    stats_t stats;
+    init_app(a, xi, yi);
+    // 等速再生時は時刻が録画時のままなので遅延は測れない
+    stats_init(&stats, realtime);
+    a->stats = &stats;
+
+    struct libevdev_uinput *mouse_uidev = NULL;
+    if (strcmp(specs->mouse, "uinput") == 0) {
+        mouse_uidev = create_virtual_mouse();
+        if (!mouse_uidev) DIE("Failed to create uinput mouse device.");
+    }
+    a->pad_out = sink_from_spec(specs->pad, NULL, xi, yi);
+    if (!a->pad_out && errno == ENODEV) DIE("Pad sink 'uinput' is not available in %s", what);
+    if (!a->pad_out) die_sink("pad", specs->pad);
+    a->mouse_out = sink_from_spec(specs->mouse, mouse_uidev, NULL, NULL);
+    if (!a->mouse_out) die_sink("mouse", specs->mouse);
+    LOG_INFO("%s. center=(%d,%d) realtime=%d", what, a->curr_x, a->curr_y, realtime);
+
+    // 等速再生でなければ入力に締め切りは無いので、キューが満杯でも捨てずに待つ
+    pipeline_t pl = {0};
+    int rc;
+    if (a->cfg.pipeline) {
+        rc = pipeline_start(&pl, a->cfg.pipeline_ring, !realtime, replay_gesture_frame, a);
+        if (rc < 0) DIE("Failed to start gesture thread: %s", strerror(-rc));
+        a->pipe = &pl;
+    }
+    // --realtime と組み合わせると低遅延モードの効果を遅延分布で比べられる
+    rt_status_t rt = { .cpu = -1 };
+    if (a->cfg.rt_mode) {
+        rt_apply(&a->cfg.rt, &rt);
+        if (pl.started) rt_apply_thread(pl.thread, rt.priority - 1, &rt);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    // realtime ではイベントが揃うまで -EAGAIN (0) が返るので、EOF まで繰り返す
+    while ((rc = drain_events(a, next, src)) == 0)
+        ;
+    if (a->pipe && a->pending.n > 0) pipeline_push(&pl, &a->pending, true);
+    pipeline_quiesce(&pl);
+    // 最後に離した後の慣性も出し切る
+    kinetic_until(a, INT64_MAX);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (rc != -ENODATA) LOG_WARN("%s stopped: rc=%d", what, rc);
+    log_flush();
+
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    unsigned long n = *events;
+    fprintf(stderr, "%s: %lu events in %.6f s (%.0f events/s, %.1f ns/event), wheel frames=%lu\n",
+            what, n, sec, sec > 0 ? n / sec : 0.0, n ? sec * 1e9 / n : 0.0, stats.wheel_frames);
+    print_sink_stats("pad", a->pad_out);
+    print_sink_stats("mouse", a->mouse_out);
+    // 最後の状態 (make check が SYN_DROPPED の後の作り直しを確かめる)
+    fprintf(stderr, "engine_state=%s\nengine_touch=%d\n", state_names[a->eng.state], a->eng.touch_down);
+    char buf[STATS_TEXT_MAX];
+    size_t len = format_stats(&stats, a->pad_out->events, a->mouse_out, &pl, &rt, 1, buf, sizeof(buf));
+    fwrite(buf, 1, len, stderr);
+
+    pipeline_stop(&pl);
+    sink_close(a->pad_out);
+    sink_close(a->mouse_out);
+    if (mouse_uidev) libevdev_uinput_destroy(mouse_uidev);
+    if (a->cfg.pad_device_path) free((void*)a->cfg.pad_device_path);
+    free(a->cfg.stats_socket);
+    free(a->cfg.device_cache);
+}
+
+// 録画ファイルを同じ状態遷移に流す
+static void run_replay(const char *path, bool realtime, const sink_specs_t *specs){
+    app_t a = {0};
+    replay_t rp;
+    load_config(&a.cfg);
+
+    int rc = replay_open(&rp, path, realtime);
+    if (rc < 0) DIE("open replay file '%s': %s", path, strerror(-rc));
+    LOG_INFO("replay file=%s", path);
+    run_offline(&a, "replay", replay_src_next_event, &rp, &rp.hdr.abs_x, &rp.hdr.abs_y,
+                realtime, specs, &rp.events);
+    replay_close(&rp);
+}
+
+typedef struct {
+    synth_t g;
+    recorder_t rec;        // --record 指定時のみ fp が非 NULL
+} synth_src_t;
+
+static int synth_src_next_event(void *src, unsigned int flags, struct input_event *ev){
+    synth_src_t *s = src;
+    int rc = synth_next_event(&s->g, flags, ev);
+    if (rc >= 0 && s->rec.fp) record_event(&s->rec, ev);
+    return rc;
+}
+
+// 合成した入力を同じ状態遷移に流す。record_path があれば録画ファイルとしても書き出す
+static void run_synth(const char *spec, bool realtime, const char *record_path, const sink_specs_t *specs){
+    app_t a = {0};
+    synth_config_t sc;
+    load_config(&a.cfg);
+
+    int rc = synth_parse(&sc, spec);
+    if (rc < 0) DIE("Invalid synth spec '%s'", spec);
+    if (sc.device[0]) {
+        // 実機と同じ ABS 範囲で作る (run() が読むのと同じ absinfo)
+        int fd = open(sc.device, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) DIE("open %s: %s", sc.device, strerror(errno));
+        struct libevdev *dev = NULL;
+        rc = libevdev_new_from_fd(fd, &dev);
+        if (rc < 0) DIE("libevdev init %s: %s", sc.device, strerror(-rc));
+        const struct input_absinfo *xi = libevdev_get_abs_info(dev, ABS_X);
+        const struct input_absinfo *yi = libevdev_get_abs_info(dev, ABS_Y);
+        if (!xi || !yi) DIE("%s has no ABS_X/ABS_Y", sc.device);
+        sc.abs_x = *xi;
+        sc.abs_y = *yi;
+        libevdev_free(dev);
+        close(fd);
+    }
+
+    synth_src_t src = {0};
+    synth_init(&src.g, &sc, realtime);
+    if (record_path) {
+        rc = recorder_open(&src.rec, record_path, &sc.abs_x, &sc.abs_y);
+        if (rc < 0) DIE("open record file '%s': %s", record_path, strerror(-rc));
+    }
+    LOG_INFO("synth rate=%dHz radius=%.2f speed=%.2frps jitter=%.4f count=%d x=%d:%d y=%d:%d duration=%.2fs",
+             sc.rate_hz, sc.radius, sc.speed, sc.jitter, sc.count,
+             sc.abs_x.minimum, sc.abs_x.maximum, sc.abs_y.minimum, sc.abs_y.maximum,
+             synth_duration(&sc));
+    run_offline(&a, "synth", synth_src_next_event, &src, &sc.abs_x, &sc.abs_y,
+                realtime, specs, &src.g.events);
+    // realtime で読み手が報告レートに追いつけているか
+    fprintf(stderr, "synth_frames=%lu\nsynth_late_frames=%lu\nsynth_max_lag_us=%lld\n",
+            src.g.frames, src.g.late_frames, (long long)src.g.max_lag_us);
+    recorder_close(&src.rec);
 }
 
 static void usage(const char *prog){
-    fprintf(stderr, "Usage: %s /dev/input/eventX\n", prog);
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -r, --record FILE   record the raw touchpad event stream to FILE\n"
+            "  -p, --replay FILE   feed a recorded stream through the gesture engine (no devices needed)\n"
+            "  -s, --synth SPEC    feed a synthetic stream (key=value,... see README) through the engine;\n"
+            "                      with --record, also write it as a replay file\n"
+            "  -t, --realtime      with --replay/--synth, keep the original event timing\n"
+            "  -c, --config FILE   read the settings from FILE only\n"
+            "      --pad-sink S    passthrough output: uinput|null|ring[:N]|file:PATH\n"
+            "                      (default: uinput, or null with --replay/--synth)\n"
+            "      --mouse-sink S  scroll output, same choices as --pad-sink\n"
+            "  -h, --help          show this help\n", prog);
 }
 
 int main(int argc, char **argv){
-    run();
+    static const struct option opts[] = {
+        { "record",   required_argument, NULL, 'r' },
+        { "replay",   required_argument, NULL, 'p' },
+        { "synth",    required_argument, NULL, 's' },
+        { "realtime", no_argument,       NULL, 't' },
+        { "config",   required_argument, NULL, 'c' },
+        { "pad-sink",   required_argument, NULL, 'P' },
+        { "mouse-sink", required_argument, NULL, 'M' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    const char *record_path = NULL, *replay_path = NULL, *synth_spec = NULL;
+    sink_specs_t specs = { NULL, NULL };
+    bool realtime = false;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "r:p:s:tc:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'r': record_path = optarg; break;
+        case 'p': replay_path = optarg; break;
+        case 's': synth_spec = optarg; break;
+        case 't': realtime = true; break;
+        case 'c': config_path = optarg; break;
+        case 'P': specs.pad = optarg; break;
+        case 'M': specs.mouse = optarg; break;
+        case 'h': usage(argv[0]); return 0;
+        default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if (replay_path && synth_spec) {
+        fprintf(stderr, "--replay and --synth are exclusive\n");
+        return 1;
+    }
+    const char *def_sink = replay_path || synth_spec ? "null" : "uinput";
+    if (!specs.pad) specs.pad = def_sink;
+    if (!specs.mouse) specs.mouse = def_sink;
+
+    log_init();
+    if (replay_path) {
+        run_replay(replay_path, realtime, &specs);
+    } else if (synth_spec) {
+        run_synth(synth_spec, realtime, record_path, &specs);
+    } else {
+        run(record_path, &specs);
+    }
+    log_shutdown();
     return 0;
 }